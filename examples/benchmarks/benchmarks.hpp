@@ -0,0 +1,8 @@
+#pragma once
+
+/*
+ * Simple timing benchmarks, run them with optimizations enabled. Every benchmark
+ * prints its own results.
+ */
+void benchmarkProxies();
+void benchmarkDbusDecoding();
@@ -0,0 +1,13 @@
+QT = core dbus
+CONFIG += console
+CONFIG -= app_bundle
+
+include("../../veutil.pri")
+
+SOURCES += \
+    dbus_decode_benchmark.cpp \
+    main.cpp \
+    proxy_benchmark.cpp \
+
+HEADERS += \
+    benchmarks.hpp \
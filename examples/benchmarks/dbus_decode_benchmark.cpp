@@ -0,0 +1,96 @@
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QEventLoop>
+
+#include <veutil/qt/ve_qitem.hpp>
+#include <veutil/qt/ve_qitem_exported_dbus_services.hpp>
+#include <veutil/qt/ve_qitems_dbus.hpp>
+
+#include "benchmarks.hpp"
+
+static const char *serviceName = "com.victronenergy.benchmark.decode";
+static const int numberOfItems = 2000;
+static const int numberOfReplies = 20;
+
+/*
+ * Applies a demarshalled reply per path, like the consumer did before it decoded
+ * while streaming. The benchmark only exports values and texts.
+ */
+static int applyItemMap(VeQItem *service, ItemMap const &items)
+{
+	for (auto it = items.constBegin(); it != items.constEnd(); ++it) {
+		VeQItem *item = service->itemGet(it.key());
+		if (!item)
+			continue;
+		item->produceValue(it.value().value("Value"));
+		item->produceText(it.value().value("Text").toString());
+	}
+	return items.size();
+}
+
+/*
+ * Exports a service with 2000 items from this process and requests GetItems from
+ * it. The replies are demarshalled into an ItemMap which is then applied per path,
+ * like it was done before, and by the streaming decoder, which applies every value
+ * as soon as it is read. Both apply the same values. Needs a session bus.
+ */
+void benchmarkDbusDecoding()
+{
+	if (!QDBusConnection::sessionBus().isConnected()) {
+		qInfo() << "[dbus decode] skipped, there is no session bus";
+		return;
+	}
+
+	VeQItem *exportRoot = new VeQItemLocal(nullptr);
+	VeQItemProducer exportProducer(exportRoot, "export");
+	VeQItem *exported = exportProducer.services()->itemGetOrCreate(serviceName, false);
+	for (int n = 0; n < numberOfItems; n++)
+		exported->itemGetOrCreateAndProduce(QString("Item/%1/Value").arg(n), n * 0.5);
+	exported->produceValue(QVariant(), VeQItem::Synchronized);
+
+	VeQItemExportedDbusServices *exporter = new VeQItemExportedDbusServices(exportProducer.services());
+	exporter->open("session");
+
+	VeQItem *consumerRoot = new VeQItemLocal(nullptr);
+	VeQItemDbusProducer *consumer = new VeQItemDbusProducer(consumerRoot, "dbus", false);
+	QEventLoop loop;
+	QObject::connect(consumer, &VeQItemDbusProducer::startupFinished, &loop, &QEventLoop::quit);
+	consumer->open("session", "benchmark");
+	consumer->services()->itemGetOrCreate(serviceName, false);
+	loop.exec();
+
+	VeDbusServicePrivate *service = consumer->dbusServiceGetOrCreate(serviceName);
+	VeQItem *serviceItem = consumer->services()->itemGet(serviceName);
+	QDBusMessage msg = QDBusMessage::createMethodCall(service->owner(), "/", "com.victronenergy.BusItem", "GetItems");
+	QList<QDBusMessage> replies;
+	for (int n = 0; n < 2 * numberOfReplies; n++)
+		replies.append(consumer->dbusConnection().call(msg, QDBus::BlockWithGui));
+
+	QElapsedTimer timer;
+	int paths = 0;
+
+	timer.start();
+	for (int n = 0; n < numberOfReplies; n++) {
+		ItemMap items = qdbus_cast<ItemMap>(replies[n].arguments().at(0));
+		paths += applyItemMap(serviceItem, items);
+	}
+	qint64 itemMap = timer.nsecsElapsed();
+
+	timer.restart();
+	for (int n = numberOfReplies; n < 2 * numberOfReplies; n++)
+		paths += service->applyItems(qvariant_cast<QDBusArgument>(replies[n].arguments().at(0)));
+	qint64 streaming = timer.nsecsElapsed();
+
+	if (paths != 2 * numberOfReplies * numberOfItems)
+		qWarning() << "[dbus decode] unexpected number of paths" << paths;
+
+	qInfo().nospace() << "[dbus decode] " << numberOfItems << " items, ItemMap demarshal and apply: "
+					  << itemMap / numberOfReplies / 1000 << " us/reply, streaming decode and apply: "
+					  << streaming / numberOfReplies / 1000 << " us/reply";
+
+	// The services refer to their root item, so remove them first.
+	delete consumer;
+	delete consumerRoot;
+	delete exporter;
+	delete exportRoot;
+}
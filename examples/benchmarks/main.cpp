@@ -0,0 +1,13 @@
+#include <QCoreApplication>
+
+#include "benchmarks.hpp"
+
+int main(int argc, char *argv[])
+{
+	QCoreApplication app(argc, argv);
+
+	benchmarkProxies();
+	benchmarkDbusDecoding();
+
+	return 0;
+}
@@ -0,0 +1,57 @@
+#include <QDebug>
+#include <QElapsedTimer>
+
+#include <veutil/qt/ve_qitem.hpp>
+
+#include "benchmarks.hpp"
+
+static const int numberOfProxies = 1000;
+static const int numberOfUpdates = 200;
+
+/*
+ * Like settings -> service -> exported tree, every source gets a chain of three
+ * proxies with a receiver on the last one. Returns the time per update in ns.
+ */
+static double runProxyChain(VeQItemProxy::Mode mode)
+{
+	VeQItem *root = new VeQItemLocal(nullptr);
+	VeQItemProducer producer(root, "producer");
+	QObject receiver;
+	QList<VeQItem *> sources;
+	int received = 0;
+
+	for (int n = 0; n < numberOfProxies; n++) {
+		QString id = QString::number(n);
+		VeQItem *source = producer.services()->itemGetOrCreateAndProduce("Settings/" + id, 0);
+		VeQItem *service = VeQItemProxy::addProxy(producer.services()->itemGetOrCreate("Service", false), id, source, mode);
+		VeQItem *tree = VeQItemProxy::addProxy(producer.services()->itemGetOrCreate("Service2", false), id, service, mode);
+		VeQItem *exported = VeQItemProxy::addProxy(producer.services()->itemGetOrCreate("Exported", false), id, tree, mode);
+
+		QObject::connect(exported, &VeQItem::valueChanged, &receiver, [&received]() { received++; });
+		sources.append(source);
+	}
+
+	QElapsedTimer timer;
+	timer.start();
+	for (int update = 1; update <= numberOfUpdates; update++) {
+		for (VeQItem *source: sources)
+			source->produceValue(update);
+	}
+	qint64 elapsed = timer.nsecsElapsed();
+
+	if (received != numberOfProxies * numberOfUpdates)
+		qWarning() << "[proxy] unexpected number of changes" << received;
+
+	delete root;
+
+	return double(elapsed) / (numberOfProxies * numberOfUpdates);
+}
+
+void benchmarkProxies()
+{
+	double relay = runProxyChain(VeQItemProxy::Relay);
+	double alias = runProxyChain(VeQItemProxy::Alias);
+
+	qInfo().nospace() << "[proxy] " << numberOfProxies << " proxy chains, relay: " << relay
+					  << " ns/update, alias: " << alias << " ns/update";
+}
@@ -0,0 +1,14 @@
+QT = core dbus
+CONFIG += console
+CONFIG -= app_bundle
+
+include("../../veutil.pri")
+
+SOURCES += \
+    load_consumer.cpp \
+    load_generator.cpp \
+    main.cpp \
+
+HEADERS += \
+    load_consumer.hpp \
+    load_generator.hpp \
@@ -0,0 +1,80 @@
+#include <algorithm>
+
+#include <QDateTime>
+#include <QDebug>
+
+#include <veutil/qt/ve_qitem.hpp>
+#include <veutil/qt/ve_qitems_dbus.hpp>
+
+#include "load_consumer.hpp"
+
+LoadConsumer::LoadConsumer(bool decodeThread, QObject *parent) :
+	QObject(parent),
+	mChanges(0)
+{
+	mRoot = new VeQItemLocal(nullptr);
+	mProducer = new VeQItemDbusProducer(mRoot, "dbus");
+	mProducer->setDecodeThread(decodeThread);
+	mProducer->setStatistics(true);
+
+	VeQItemDbusFilter filter;
+	filter.includeServices({"com.victronenergy.loadgen"});
+	mProducer->setFilter(filter);
+
+	connect(mProducer, &VeQItemDbusProducer::startupFinished, this, &LoadConsumer::startupFinished);
+	connect(&mReportTimer, &QTimer::timeout, this, &LoadConsumer::report);
+}
+
+LoadConsumer::~LoadConsumer()
+{
+	// The services refer to their root item, so remove them first.
+	delete mProducer;
+	delete mRoot;
+}
+
+bool LoadConsumer::open(QString const &address)
+{
+	return mProducer->open(address, "loadconsumer");
+}
+
+void LoadConsumer::startupFinished()
+{
+	int items = 0;
+
+	mProducer->services()->foreachChildFirst([this, &items](VeQItem *item) {
+		if (!item->isLeaf())
+			return;
+
+		items++;
+		if (item->id() == "Timestamp") {
+			connect(item, &VeQItem::valueChanged, this, [this](QVariant value) {
+				if (value.isValid())
+					mLatencies.append(QDateTime::currentMSecsSinceEpoch() - value.toLongLong());
+			});
+		} else {
+			connect(item, &VeQItem::valueChanged, this, [this]() { mChanges++; });
+		}
+	});
+
+	qInfo() << "[consumer] startup finished," << items << "items";
+	qInfo().noquote() << mProducer->startupReport();
+
+	mReportTimer.start(1000);
+}
+
+void LoadConsumer::report()
+{
+	qint64 p50 = -1;
+	qint64 p99 = -1;
+
+	if (!mLatencies.isEmpty()) {
+		std::sort(mLatencies.begin(), mLatencies.end());
+		p50 = mLatencies[mLatencies.size() / 2];
+		p99 = mLatencies[qMin(mLatencies.size() - 1, mLatencies.size() * 99 / 100)];
+	}
+
+	qInfo().nospace() << "[consumer] " << mChanges << " changes/s, latency p50 " << p50 << " ms, p99 " << p99 << " ms";
+
+	mChanges = 0;
+	mLatencies.clear();
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <QObject>
+#include <QTimer>
+#include <QVector>
+
+class VeQItem;
+class VeQItemDbusProducer;
+
+/*
+ * Imports the services of a LoadGenerator with a VeQItemDbusProducer and reports
+ * the number of changes received per second and the latency of the changes, as
+ * measured by the /Timestamp item of the services.
+ */
+class LoadConsumer : public QObject
+{
+	Q_OBJECT
+
+public:
+	LoadConsumer(bool decodeThread, QObject *parent = nullptr);
+	~LoadConsumer();
+
+	bool open(QString const &address);
+
+private slots:
+	void startupFinished();
+	void report();
+
+private:
+	VeQItem *mRoot;
+	VeQItemDbusProducer *mProducer;
+	QTimer mReportTimer;
+	quint64 mChanges;
+	QVector<qint64> mLatencies;
+};
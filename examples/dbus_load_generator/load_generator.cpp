@@ -0,0 +1,106 @@
+#include <QDateTime>
+#include <QDebug>
+
+#include <veutil/qt/ve_qitem.hpp>
+#include <veutil/qt/ve_qitem_exported_dbus_services.hpp>
+
+#include "load_generator.hpp"
+
+LoadGenerator::LoadGenerator(int services, int items, double changesPerSecond, QStringList const &types,
+							 QObject *parent) :
+	QObject(parent),
+	mTypes(types),
+	mChangesPerTick(services * changesPerSecond * tickMs / 1000.0),
+	mPendingChanges(0),
+	mChanges(0),
+	mReportedChanges(0),
+	mNextItem(0),
+	mCounter(0),
+	mExporter(nullptr)
+{
+	mRoot = new VeQItemLocal(nullptr);
+	mProducer = new VeQItemProducer(mRoot, "loadgen");
+
+	for (int s = 0; s < services; s++) {
+		VeQItem *service = mProducer->services()->itemGetOrCreate(QString("com.victronenergy.loadgen.%1").arg(s), false);
+		service->itemGetOrCreateAndProduce("Timestamp", QDateTime::currentMSecsSinceEpoch());
+		mServices.append(service);
+	}
+
+	// Item major, so the changes are spread over the services.
+	for (int n = 0; n < items; n++) {
+		for (VeQItem *service: mServices) {
+			VeQItem *item = service->itemGetOrCreate(QString("Load/%1").arg(n));
+			mItems.append(item);
+			item->produceValue(nextValue(mItems.size() - 1));
+		}
+	}
+
+	// Services are only exported once they are synchronized.
+	for (VeQItem *service: mServices)
+		service->produceValue(QVariant(), VeQItem::Synchronized);
+
+	connect(&mTickTimer, &QTimer::timeout, this, &LoadGenerator::tick);
+	connect(&mReportTimer, &QTimer::timeout, this, [this]() {
+		qInfo() << "[loadgen]" << mChanges - mReportedChanges << "changes/s";
+		mReportedChanges = mChanges;
+	});
+}
+
+LoadGenerator::~LoadGenerator()
+{
+	// The exported services refer to their items, so they go first.
+	delete mExporter;
+	delete mProducer;
+	delete mRoot;
+}
+
+bool LoadGenerator::open(QString const &address)
+{
+	mExporter = new VeQItemExportedDbusServices(mProducer->services());
+	if (!mExporter->open(address))
+		return false;
+
+	qInfo() << "[loadgen]" << mServices.size() << "services," << mItems.size() / qMax(1, mServices.size())
+			<< "items each," << mChangesPerTick * 1000 / tickMs << "changes/s in total, types" << mTypes;
+
+	mTickTimer.start(tickMs);
+	mReportTimer.start(1000);
+
+	return true;
+}
+
+void LoadGenerator::tick()
+{
+	if (mItems.isEmpty())
+		return;
+
+	mPendingChanges += mChangesPerTick;
+	while (mPendingChanges >= 1) {
+		mPendingChanges -= 1;
+		mItems[mNextItem]->produceValue(nextValue(mNextItem));
+		mNextItem = (mNextItem + 1) % mItems.size();
+		mChanges++;
+	}
+
+	qint64 now = QDateTime::currentMSecsSinceEpoch();
+	for (VeQItem *service: mServices)
+		service->itemGet("Timestamp")->produceValue(now);
+}
+
+QVariant LoadGenerator::nextValue(int item)
+{
+	QString const &type = mTypes.at(item % mTypes.size());
+	int counter = mCounter++;
+
+	if (type == "int")
+		return counter;
+	if (type == "string")
+		return QString("value %1").arg(counter);
+	if (type == "list")
+		return QVariantList{counter, counter * 0.5, QString::number(counter)};
+	if (type == "map")
+		return QVariantMap{{"Counter", counter}, {"Half", counter * 0.5}};
+
+	return counter * 0.1;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <QList>
+#include <QObject>
+#include <QStringList>
+#include <QTimer>
+
+class VeQItem;
+class VeQItemProducer;
+class VeQItemExportedDbusServices;
+
+/*
+ * Exports a number of com.victronenergy.loadgen.<n> services with a number of items
+ * each and changes their values at a fixed rate. Values are of the given types,
+ * assigned round robin to the items: double, int, string, list or map.
+ *
+ * Every service also has a /Timestamp item, set to the time of the last update in
+ * ms since the epoch, so a consumer can measure the latency of the changes.
+ */
+class LoadGenerator : public QObject
+{
+	Q_OBJECT
+
+public:
+	LoadGenerator(int services, int items, double changesPerSecond, QStringList const &types,
+				  QObject *parent = nullptr);
+	~LoadGenerator();
+
+	bool open(QString const &address);
+
+private slots:
+	void tick();
+
+private:
+	QVariant nextValue(int item);
+
+	static const int tickMs = 10;
+
+	QStringList mTypes;
+	double mChangesPerTick;
+	double mPendingChanges;
+	quint64 mChanges;
+	quint64 mReportedChanges;
+	int mNextItem;
+	int mCounter;
+
+	VeQItem *mRoot;
+	VeQItemProducer *mProducer;
+	VeQItemExportedDbusServices *mExporter;
+	QList<VeQItem *> mServices;
+	QList<VeQItem *> mItems;
+	QTimer mTickTimer;
+	QTimer mReportTimer;
+};
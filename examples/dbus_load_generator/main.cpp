@@ -0,0 +1,72 @@
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDebug>
+#include <QTimer>
+
+#include "load_consumer.hpp"
+#include "load_generator.hpp"
+
+/*
+ * Generates dbus traffic with exported services, consumes it with a
+ * VeQItemDbusProducer, or both. See run_private_bus.sh to run it against a private
+ * session bus, so it works without a Venus device and doesn't disturb other users
+ * of the bus.
+ */
+int main(int argc, char *argv[])
+{
+	QCoreApplication app(argc, argv);
+
+	QCommandLineParser parser;
+	parser.setApplicationDescription("Synthetic dbus load for benchmarking the VeQItem dbus producer and exporter");
+	parser.addHelpOption();
+	parser.addOptions({
+		{"mode", "generate, consume or both (default).", "mode", "both"},
+		{"address", "The dbus to use, session (default), system or an address.", "address", "session"},
+		{"services", "Number of services to generate (default 10).", "count", "10"},
+		{"items", "Number of items per service (default 100).", "count", "100"},
+		{"rate", "Value changes per second per service (default 100).", "rate", "100"},
+		{"types", "Comma separated value types: double, int, string, list, map (default all).", "types",
+		 "double,int,string,list,map"},
+		{"decode-thread", "Let the consumer decode on a separate thread."},
+		{"duration", "Stop after this many seconds, 0 runs forever (default).", "seconds", "0"},
+	});
+	parser.process(app);
+
+	QString mode = parser.value("mode");
+	QString address = parser.value("address");
+	LoadGenerator *generator = nullptr;
+	LoadConsumer *consumer = nullptr;
+
+	if (mode == "generate" || mode == "both") {
+		generator = new LoadGenerator(parser.value("services").toInt(), parser.value("items").toInt(),
+									  parser.value("rate").toDouble(), parser.value("types").split(','));
+		if (!generator->open(address)) {
+			qCritical() << "Could not export the services on" << address;
+			return 1;
+		}
+	}
+
+	if (mode == "consume" || mode == "both") {
+		consumer = new LoadConsumer(parser.isSet("decode-thread"));
+		if (!consumer->open(address)) {
+			qCritical() << "Could not connect to" << address;
+			return 1;
+		}
+	}
+
+	if (!generator && !consumer) {
+		qCritical() << "Unknown mode" << mode;
+		return 1;
+	}
+
+	int duration = parser.value("duration").toInt();
+	if (duration > 0)
+		QTimer::singleShot(duration * 1000, &app, &QCoreApplication::quit);
+
+	int ret = app.exec();
+
+	delete consumer;
+	delete generator;
+
+	return ret;
+}
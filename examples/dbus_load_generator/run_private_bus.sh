@@ -0,0 +1,60 @@
+#!/bin/sh
+#
+# Runs dbus_load_generator against a private session bus, e.g. on a CI machine:
+#
+#   ./run_private_bus.sh ./dbus_load_generator --services 20 --items 500 --duration 30
+#
+# All arguments are passed on as is. When --mode is not given, the generator and the
+# consumer run in separate processes, so the changes really pass the bus daemon.
+
+set -e
+
+if [ $# -eq 0 ]; then
+	echo "usage: $0 <dbus_load_generator> [options]" >&2
+	exit 1
+fi
+
+bin="$1"
+shift
+
+config=$(mktemp)
+address_file=$(mktemp)
+cleanup() {
+	[ -n "$generator" ] && kill "$generator" 2>/dev/null || true
+	[ -n "$daemon" ] && kill "$daemon" 2>/dev/null || true
+	rm -f "$config" "$address_file"
+}
+trap cleanup EXIT INT TERM
+
+# The default session config, but with a limit on the queued messages large enough
+# not to disconnect a slow consumer halfway through a run.
+cat > "$config" <<EOF
+<!DOCTYPE busconfig PUBLIC "-//freedesktop//DTD D-Bus Bus Configuration 1.0//EN"
+ "http://www.freedesktop.org/standards/dbus/1.0/busconfig.dtd">
+<busconfig>
+  <include>/usr/share/dbus-1/session.conf</include>
+  <limit name="max_incoming_bytes">1000000000</limit>
+  <limit name="max_outgoing_bytes">1000000000</limit>
+</busconfig>
+EOF
+
+dbus-daemon --config-file="$config" --nofork --print-address=3 3>"$address_file" &
+daemon=$!
+
+while [ ! -s "$address_file" ]; do
+	sleep 0.1
+done
+DBUS_SESSION_BUS_ADDRESS=$(head -n 1 "$address_file")
+export DBUS_SESSION_BUS_ADDRESS
+
+case " $* " in
+*" --mode "*|*" --mode="*)
+	"$bin" "$@"
+	;;
+*)
+	"$bin" --mode generate "$@" &
+	generator=$!
+	sleep 1
+	"$bin" --mode consume "$@"
+	;;
+esac
@@ -1,22 +1,21 @@
 #pragma once
 
+#include <QElapsedTimer>
 #include <QObject>
-#include <QTimer>
 #include <veutil/qt/daemontools_service.hpp>
 #include <veutil/qt/ve_qitem_utils.hpp>
 
 class VeQItemCanStats : public VeQItemExportedLeaf
 {
 public:
-	explicit VeQItemCanStats(QString const &interface) :
-		VeQItemExportedLeaf(),
-		mInterface(interface)
-	{}
+	explicit VeQItemCanStats(QString const &interface);
 
 	QVariant getValue() override;
 
 private:
 	QString mInterface;
+	QElapsedTimer mLastRun;
+	QString mStats;
 };
 
 
@@ -137,10 +136,10 @@ public:
 
 private slots:
 	void dbusItemChanged();
-	void onPollTimer();
 
 private:
 	void changeCanBusBitRate(int speed);
+	void poll();
 	void checkSpiStats();
 	void checkFailed();
 
@@ -150,5 +149,4 @@ private:
 	CanBusConfig mConfig;
 	QString mUiName;
 	VeQItem *mInterfaceItem;
-	QTimer mTimer;
 };
@@ -21,6 +21,7 @@
 
 class VeQItem;
 class VeQItemProducer;
+class VeQItemProxy;
 
 /*
  * Just a helper to invoke a slots as callback functions.
@@ -258,6 +259,13 @@ public:
 
 	QString getLastValidText() { return mLastValidText; } const
 
+	/**
+	 * Items which derive their text from their value, like formatted quantities,
+	 * return true. They create the text when it is asked for, so consumers like the
+	 * exporter should send it along with the value instead of waiting for textChanged.
+	 */
+	virtual bool hasDerivedText() const { return false; }
+
 	/**
 	 * always returns the local text, don't try to fetch it.
 	 */
@@ -328,6 +336,15 @@ public:
 	 */
 	bool getSeen() { return mSeen; }
 
+	/**
+	 * returns if there is a receiver interested in value changes of this item.
+	 *
+	 * This checks the receivers, so it is up to date. watchedStateChanged is emitted
+	 * along with watchedChanged, so when the watched state is updated by
+	 * getValueAndChanges and disconnectNotify.
+	 */
+	bool isWatched() const;
+
 	bool getSensitive() { return mSensitive; }
 	void setSensitive(bool sensitive) {
 		if (mSensitive == sensitive)
@@ -381,7 +398,7 @@ public:
 
 	VeQItem *itemAddChild(QString id, VeQItem *item);
 	void itemRemoveChild(VeQItem *child);
-	void itemDeleteChild(VeQItem *child);
+	virtual void itemDeleteChild(VeQItem *child);
 	void itemDelete();
 
 	/// Returns the relative path from `ancestor` to `this`.
@@ -392,11 +409,18 @@ public:
 signals:
 	void dynamicPropertyChanged(char const *name, QVariant var);
 	void valueChanged(QVariant var);
+	/*
+	 * Emitted when the value changed as well, but also by items which only build the
+	 * QVariant once it is asked for, see VeQItemTyped. Receivers get the value
+	 * themselves, like the exporter, so they don't count as watching the item.
+	 */
+	void valueInvalidated();
 	void getValueResult(VeQItemEvent const *error);
 	void setValueResult(VeQItemEvent const *error);
 	void textChanged(QString text);
 	void seenChanged();
 	void sensitiveChanged();
+	void watchedStateChanged();
 
 	// internal, used by getValueAndChanges
 	void initValue(QVariant var);
@@ -425,6 +449,10 @@ protected:
 	// last point before the item is announced
 	virtual void setParent(QObject *parent);
 
+	// Also counts the receivers of aliases, see VeQItemProxy::Alias.
+	bool hasTextReceivers();
+	void notifyValueInvalidated();
+
 	void reportSetValueResult(VeQItemEvent const &ev) { emit setValueResult(&ev); }
 	void reportGetValueResult(VeQItemEvent const &ev) { emit getValueResult(&ev); }
 
@@ -435,6 +463,9 @@ protected slots:
 private:
 	void uniqueId(QString &uid);
 	void updateWatched();
+	void notifyValueChanged(QVariant const &value);
+	void notifyTextChanged(QString const &text);
+	void notifyPropertyChanged(char const *name, QVariant const &value);
 
 protected:
 	QString mId;
@@ -456,24 +487,41 @@ protected:
 	bool mSeen;
 	bool mSensitive;
 	QHash<QString, State> mPropertyState;
+
+private:
+	QList<VeQItemProxy *> *mAliases;
+
+	friend class VeQItemProxy;
 };
 
 // The item proxy can forward values between items, e.g. between a settings and an
 // exported item. Proxy items can only be added, not auto created!
+//
+// By default the proxy relays the signals of its source. An Alias is instead notified
+// by the (original) source directly, so there are no intermediate signals and a chain
+// of aliases costs the same as a single one. Both forward the getters to the source.
+// Once the source of an alias is destructed, the alias has an invalid value.
 class VE_QITEM_EXPORT VeQItemProxy : public VeQItem
 {
 	Q_OBJECT
 
 public:
-	VeQItemProxy(VeQItem *srcItem);
+	enum Mode {
+		Relay,
+		Alias
+	};
+
+	VeQItemProxy(VeQItem *srcItem, Mode mode = Relay);
+	~VeQItemProxy();
 
 	using VeQItem::getValue;
-	QVariant getValue(bool force) override { return mSrcItem->getValue(force); }
-	QVariant getLocalValue() override { return mSrcItem->getLocalValue(); }
+	QVariant getValue(bool force) override { return mSrcItem ? mSrcItem->getValue(force) : QVariant(); }
+	QVariant getLocalValue() override { return mSrcItem ? mSrcItem->getLocalValue() : QVariant(); }
 	using VeQItem::getText;
-	QString getText(bool force) override { return mSrcItem->getText(force); }
-	int setValue(QVariant const &value) override { return mSrcItem->setValue(value); }
-	QVariant itemProperty(const char *name) override { return mSrcItem->itemProperty(name); }
+	QString getText(bool force) override { return mSrcItem ? mSrcItem->getText(force) : QString(); }
+	int setValue(QVariant const &value) override { return mSrcItem ? mSrcItem->setValue(value) : -1; }
+	QVariant itemProperty(const char *name) override { return mSrcItem ? mSrcItem->itemProperty(name) : QVariant(); }
+	bool hasDerivedText() const override { return mSrcItem && mSrcItem->hasDerivedText(); }
 
 	// Helper / reminder that proxy items should be added, e.g.
 	//
@@ -483,13 +531,20 @@ public:
 	// Will make the setting available as /Service/AccessPoint/Enabled and it will be stored
 	// in localsettings.
 	//
-	static VeQItemProxy *addProxy(VeQItem *targetTree, QString targetId, VeQItem *srcItem)
+	static VeQItemProxy *addProxy(VeQItem *targetTree, QString targetId, VeQItem *srcItem,
+								  Mode mode = Relay)
 	{
-		VeQItemProxy *ret = new VeQItemProxy(srcItem);
+		VeQItemProxy *ret = new VeQItemProxy(srcItem, mode);
 		targetTree->itemAddChild(targetId, ret);
 		return ret;
 	}
 
+	VeQItem *sourceItem() { return mSrcItem; }
+	Mode mode() const { return mMode; }
+
+protected:
+	void watchedChanged() override;
+
 private:
 	VeQItem *itemChild(int n);
 	VeQItem *itemGet(QString uid);
@@ -497,6 +552,9 @@ private:
 	VeQItem *itemGetOrCreateAndProduce(QString uid, QVariant value);
 
 	VeQItem *mSrcItem;
+	Mode mMode;
+
+	friend class VeQItem;
 };
 
 Q_DECLARE_METATYPE(VeQItem *)
@@ -669,6 +727,21 @@ public:
 		return root()->itemGetOrCreate("Settings/" + path);
 	}
 
+	/*
+	 * Like addSettings, but doesn't wait for the settings to be created. done is called
+	 * with the item of every setting, in the order of info, or nullptr for a setting which
+	 * could not be added. By default this is just addSettings, see VeQItemSettingsAsync.
+	 */
+	virtual void addSettingsAsync(VeQItemSettingsInfo const &info,
+								  std::function<void (QList<VeQItem *> const &items)> const &done)
+	{
+		bool ok = addSettings(info);
+		QList<VeQItem *> items;
+		for (VeQItemSettingInfo const &setting: info.info())
+			items.append(ok ? root()->itemGet("Settings/" + setting.mPath) : nullptr);
+		done(items);
+	}
+
 protected:
 	VeQItem *mRoot;
 };
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <functional>
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QMultiMap>
+#include <QObject>
+#include <QTimer>
+
+#include <veutil/qt/ve_qitem.hpp>
+
+/**
+ * @brief Refreshes items which need to be polled, like values obtained from sysfs
+ * or by running a process, instead of every producer having its own timers.
+ *
+ * Items are only polled while they are watched, see VeQItem::isWatched, unless
+ * registered with PollAlways. Exporting an item doesn't make it watched, so items
+ * which should be sent on the bus when changed need PollAlways. Everything which becomes due within the coalescing
+ * window is handled in a single wakeup, ordered by priority. When the number of
+ * polls per wakeup is limited, lower priorities are postponed to the next wakeup,
+ * alarms never are.
+ *
+ * Example:
+ *
+ * VeQItemPollScheduler::instance()->add(item, [](VeQItem *item) {
+ *		item->produceValue(readTemperature());
+ *	}, 5000, VeQItemPollScheduler::Alarm);
+ */
+class VE_QITEM_EXPORT VeQItemPollScheduler : public QObject
+{
+	Q_OBJECT
+
+public:
+	enum Priority {
+		Alarm,
+		Normal,
+		Cosmetic
+	};
+
+	enum Mode {
+		PollWhenWatched,
+		PollAlways
+	};
+
+	typedef std::function<void(VeQItem *item)> Poller;
+
+	explicit VeQItemPollScheduler(QObject *parent = 0);
+
+	static VeQItemPollScheduler *instance();
+
+	// Registering an item again replaces its previous registration. Watched and always
+	// polled items are polled before this returns.
+	void add(VeQItem *item, Poller const &poller, int periodMs, Priority priority = Normal,
+			 Mode mode = PollWhenWatched);
+	void remove(VeQItem *item);
+
+	void setCoalescingWindow(int ms) { mCoalescingWindow = ms; }
+	void setMaxPollsPerWakeup(int count) { mMaxPollsPerWakeup = count; }
+
+private slots:
+	void onWakeup();
+	void onWatchedStateChanged();
+	void onItemDestroyed(QObject *obj);
+
+private:
+	struct Entry {
+		Poller poller;
+		int period;
+		Priority priority;
+		Mode mode;
+		qint64 due;
+	};
+
+	void schedule(VeQItem *item, Entry &entry, qint64 due);
+	void unschedule(VeQItem *item, Entry const &entry);
+	void rearm();
+	qint64 nextDue(Entry const &entry, qint64 now);
+
+	QHash<VeQItem *, Entry> mEntries;
+	QMultiMap<qint64, VeQItem *> mQueue;
+	QElapsedTimer mClock;
+	QTimer mTimer;
+	int mCoalescingWindow;
+	int mMaxPollsPerWakeup;
+};
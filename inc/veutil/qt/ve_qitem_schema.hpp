@@ -0,0 +1,61 @@
+#pragma once
+
+#include <limits>
+
+#include <QMetaType>
+
+#include <veutil/qt/ve_qitem.hpp>
+
+/*
+ * Static description of an exported item. Besides building a service in one pass,
+ * see VeQItemSchema, such a table documents the paths of the service, e.g.
+ *
+ * static constexpr VeQItemSchemaEntry batterySchema[] = {
+ *	{"Dc/0/Voltage", QMetaType::Double, "V", 2},
+ *	{"Dc/0/Current", QMetaType::Double, "A", 1},
+ *	{"Soc", QMetaType::Double, "%", 0, 0, 100},
+ *	{"Mode", QMetaType::Int, "", -1, 0, 3, 1},
+ * };
+ *
+ * Min, max and the default value are only set when given, the default is also the
+ * initial value of the item. Values produced on the item are converted to the type,
+ * the unit is appended to the text and decimals only apply to floating point types.
+ */
+struct VeQItemSchemaEntry
+{
+	static constexpr double unset = std::numeric_limits<double>::quiet_NaN();
+
+	char const *path;
+	QMetaType::Type type = QMetaType::Double;
+	char const *unit = "";
+	int decimals = -1;
+	double min = unset;
+	double max = unset;
+	double defaultValue = unset;
+};
+
+class VE_QITEM_EXPORT VeQItemSchema
+{
+public:
+	/*
+	 * Creates the items of the schema below serviceRoot, items which already exist are
+	 * left alone. Missing branches are built detached and then added as a whole, so
+	 * there is a single childAdded per new branch instead of one per item. When the
+	 * serviceRoot itself is not added yet, it can be added afterwards in one go as well.
+	 *
+	 * The serviceRoot must have a producer, it creates the intermediate nodes.
+	 */
+	static void build(VeQItem *serviceRoot, VeQItemSchemaEntry const *entries, int count);
+
+	template<int N>
+	static void build(VeQItem *serviceRoot, VeQItemSchemaEntry const (&entries)[N])
+	{
+		build(serviceRoot, entries, N);
+	}
+
+	// Creates the leaf for a single entry, holding values of the entry its type.
+	static VeQItem *createLeaf(VeQItemSchemaEntry const &entry);
+
+private:
+	static QVariant toVariant(QMetaType::Type type, double value);
+};
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <QFuture>
+#include <QList>
+#include <QObject>
+#include <QPromise>
+#include <QSharedPointer>
+
+#include <veutil/qt/ve_qitem.hpp>
+
+/**
+ * @brief Adds settings without waiting for them to be created.
+ *
+ * The settings added during an event loop iteration are combined into a single
+ * VeQItemSettings::addSettingsAsync, for VeQItemDbusSettings a single AddSettings call
+ * which doesn't block. The future results in the item of the setting, or nullptr if
+ * the setting could not be added.
+ *
+ * Example:
+ *
+ * VeQItemSettingsAsync *async = new VeQItemSettingsAsync(settings, this);
+ * async->add("Gui/Brightness", 100, 0, 100).then(this, [](VeQItem *item) { ... });
+ */
+class VE_QITEM_EXPORT VeQItemSettingsAsync : public QObject
+{
+	Q_OBJECT
+
+public:
+	VeQItemSettingsAsync(VeQItemSettings *settings, QObject *parent = nullptr);
+
+	QFuture<VeQItem *> add(QString path, QVariant defaultValue,
+						   QVariant min = QVariant(), QVariant max = QVariant(),
+						   bool silent = false);
+
+signals:
+	// Emitted after the futures of the settings added together are finished.
+	void settingsAdded(bool success);
+
+private:
+	typedef QSharedPointer<QPromise<VeQItem *>> SettingPromise;
+
+	void flush();
+
+	VeQItemSettings *mSettings;
+	VeQItemSettingsInfo mPending;
+	QList<SettingPromise> mPromises;
+};
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <map>
+#include <type_traits>
+
 #include <QString>
 
 #include <veutil/qt/ve_qitem.hpp>
@@ -35,13 +37,98 @@ public:
 	}
 };
 
-class VeQItemQuantity : public VeQItemExportedLeaf
+/*
+ * A leaf with a text formatted from its value. Many exported values are updated far
+ * more often than their text is looked at, so the text is only formatted when asked
+ * for, or right away when there are receivers of textChanged. The formatted text is
+ * kept until the value changes. Since the text is derived from the value, it can't be
+ * produced directly.
+ *
+ * NOTE: getLastValidText isn't virtual, it is only up to date while the text is watched,
+ * or once getText has been called.
+ */
+class VeQItemFormattedLeaf : public VeQItemExportedLeaf
 {
 	Q_OBJECT
 
 public:
-	VeQItemQuantity(int decimals = -1, QString const &unit = "", QVariant const &initial = QVariant()) :
+	VeQItemFormattedLeaf() :
 		VeQItemExportedLeaf(),
+		mTextStale(false)
+	{}
+
+	using VeQItem::getText;
+	QString getText(bool force) override
+	{
+		Q_UNUSED(force);
+
+		// Nobody listened to textChanged when it went stale, so don't signal from a getter.
+		if (mTextStale) {
+			mTextStale = false;
+			mText = formatText(mValue);
+			if (!mText.isNull())
+				mLastValidText = mText;
+		}
+		return mText;
+	}
+
+	bool hasDerivedText() const override { return true; }
+
+	// Previews are the exception, see VeQItem::produceValue.
+	void produceText(QString text, State state = Synchronized) override
+	{
+		if (state != Preview) {
+			qDebug() << "The text of" << uniqueId() << "is derived from its value and cannot be produced";
+			Q_ASSERT(false);
+			return;
+		}
+
+		VeQItem::produceText(text, state);
+	}
+
+	void produceValue(QVariant value, State state = Synchronized, bool forceChanged = false) override
+	{
+		// Previewing keeps a copy of the text around, keep it simple and format directly.
+		if (state == Preview || mState == Preview) {
+			VeQItem::produceValue(value, state, forceChanged);
+			mTextStale = false;
+			VeQItem::produceText(formatText(value), state);
+			return;
+		}
+
+		bool changed = forceChanged || mState != state || mValue != value;
+		VeQItem::produceValue(value, state, forceChanged);
+		if (!changed)
+			return;
+
+		mTextStale = true;
+		if (hasTextReceivers())
+			updateText();
+		else
+			setTextState(state);
+	}
+
+protected:
+	virtual QString formatText(QVariant const &value) = 0;
+	void invalidateText() { mTextStale = true; }
+
+private:
+	void updateText()
+	{
+		mTextStale = false;
+		VeQItem::produceText(formatText(mValue), mState);
+	}
+
+	bool mTextStale;
+};
+
+class VeQItemQuantity : public VeQItemFormattedLeaf
+{
+	Q_OBJECT
+
+public:
+	VeQItemQuantity(int decimals = -1, QString const &unit = "", QVariant const &initial = QVariant()) :
+		VeQItemFormattedLeaf(),
 		mDecimals(decimals),
 		mUnit(unit)
 	{
@@ -49,29 +136,26 @@ public:
 	}
 
 	VeQItemQuantity(QVariant const &initial) :
-		VeQItemExportedLeaf(),
+		VeQItemFormattedLeaf(),
 		mDecimals(-1),
 		mUnit("")
 	{
 		produceValue(initial);
 	}
 
-	void produceValue(QVariant value, State state = Synchronized, bool forceChanged = false) override
+protected:
+	QString formatText(QVariant const &value) override
 	{
-		VeQItem::produceValue(value, state, forceChanged);
+		if (!value.isValid())
+			return "-";
 
-		QString text;
-		if (!value.isValid()) {
-			text = "-";
-		} else if (mDecimals >= 0) {
+		if (mDecimals >= 0) {
 			bool ok;
 			double number = value.toDouble(&ok);
-			text = ok ? QString::number(number, 'f', mDecimals) + mUnit : "";
-		} else {
-			text = value.toString();
+			return ok ? QString::number(number, 'f', mDecimals) + mUnit : "";
 		}
 
-		VeQItem::produceText(text, state);
+		return value.toString();
 	}
 
 private:
@@ -84,31 +168,26 @@ private:
  * Perhaps reflection / the metatype system can do this automagically,
  * for now it just needs to be spelled out.
  */
-class VeQItemEnum : public VeQItemExportedLeaf
+class VeQItemEnum : public VeQItemFormattedLeaf
 {
 	Q_OBJECT
 
 public:
 	VeQItemEnum(std::map<int, QString> const &values) :
-		VeQItemExportedLeaf(),
+		VeQItemFormattedLeaf(),
 		mValues(values)
 	{}
 
-	void produceValue(QVariant value, State state = Synchronized, bool forceChanged = false) override
+protected:
+	QString formatText(QVariant const &value) override
 	{
-		VeQItem::produceValue(value, state, forceChanged);
-
 		bool ok;
 		int val = value.toInt(&ok);
-		QString text;
-		if (ok) {
-			std::map<int, QString>::const_iterator it = mValues.find(val);
-			text = it == mValues.end() ? "-" : it->second;
-		} else {
-			text= "-";
-		}
+		if (!ok)
+			return "-";
 
-		VeQItem::produceText(text, state);
+		std::map<int, QString>::const_iterator it = mValues.find(val);
+		return it == mValues.end() ? "-" : it->second;
 	}
 
 private:
@@ -116,6 +195,182 @@ private:
 };
 
 
+/*
+ * Format policies for VeQItemTyped, formatting at compile time known decimals and
+ * units. A unit is a type with a static text, e.g.
+ *
+ * struct VeUnitVolt { static constexpr char const *text = "V"; };
+ * typedef VeQItemTyped<double, VeQItemDecimalFormat<2, VeUnitVolt>> VeQItemVoltage;
+ */
+struct VeQItemNoUnit
+{
+	static constexpr char const *text = "";
+};
+
+template<int Decimals, typename Unit = VeQItemNoUnit>
+struct VeQItemDecimalFormat
+{
+	template<typename T>
+	static QString format(T const &value)
+	{
+		return QString::number(static_cast<double>(value), 'f', Decimals) + QLatin1String(Unit::text);
+	}
+};
+
+template<typename Unit = VeQItemNoUnit>
+struct VeQItemPlainFormat
+{
+	template<typename T>
+	static QString format(T const &value)
+	{
+		if constexpr (std::is_arithmetic<T>::value)
+			return QString::number(value) + QLatin1String(Unit::text);
+		else
+			return QVariant::fromValue(value).toString() + QLatin1String(Unit::text);
+	}
+};
+
+/*
+ * An exported leaf which stores its value as a native T. Producing a value through
+ * produceNative compares it natively, so an unchanged value doesn't create or compare
+ * QVariants at all. While nobody is connected to the value or text, except receivers of
+ * valueInvalidated like the exporter, a changed value is only stored natively as well and
+ * the QVariant is built once it is asked for. Towards the exporter and other consumers it
+ * is a normal VeQItem with a value of type T, values which can't be converted to T are
+ * ignored.
+ *
+ * NOTE: since this is a template it can't have Q_OBJECT, so it can't add signals or slots.
+ * NOTE: getLastValidValue isn't virtual, it is only up to date while the value is watched,
+ * which is always the case for a VeQuickItem.
+ */
+template<typename T, typename Format = VeQItemPlainFormat<>>
+class VeQItemTyped : public VeQItemFormattedLeaf
+{
+public:
+	VeQItemTyped() :
+		VeQItemFormattedLeaf(),
+		mNative(),
+		mNativeValid(false),
+		mValueStale(false)
+	{
+		init();
+		produceValue(QVariant());
+	}
+
+	explicit VeQItemTyped(T const &initial) :
+		VeQItemFormattedLeaf(),
+		mNative(),
+		mNativeValid(false),
+		mValueStale(false)
+	{
+		init();
+		produceNative(initial);
+	}
+
+	// The current value, so also the previewed one while previewing.
+	T const &native() const { return mNative; }
+	bool isNativeValid() const { return mNativeValid; }
+
+	void produceNative(T const &value, State state = Synchronized)
+	{
+		if (mNativeValid && mState == state && mNative == value)
+			return;
+
+		// The value is kept aside while previewing, let VeQItem sort that out.
+		if (mState == Preview || state == Preview) {
+			produceValue(QVariant::fromValue(value), state);
+			return;
+		}
+
+		mNative = value;
+		mNativeValid = true;
+
+		// Nobody needs the new value right away, so there is no need to build the QVariant yet.
+		if (mSeen && mState == state && !isWatched() && !hasTextReceivers()) {
+			mValueStale = true;
+			invalidateText();
+			notifyValueInvalidated();
+			return;
+		}
+
+		mValueStale = false;
+		VeQItemFormattedLeaf::produceValue(QVariant::fromValue(mNative), state);
+	}
+
+	// Generic values, e.g. set by QVariant based code, are converted to T first.
+	void produceValue(QVariant value, State state = Synchronized, bool forceChanged = false) override
+	{
+		QVariant native = value;
+		if (native.isValid() && !native.convert(QMetaType::fromType<T>())) {
+			qDebug() << "ignoring value" << value << "for" << uniqueId()
+					 << "since it isn't a" << QMetaType::fromType<T>().name();
+			return;
+		}
+
+		buildValue();
+		VeQItemFormattedLeaf::produceValue(native, state, forceChanged);
+		syncNative();
+	}
+
+	using VeQItemFormattedLeaf::getValue;
+	QVariant getValue(bool force) override
+	{
+		buildValue();
+		return VeQItemFormattedLeaf::getValue(force);
+	}
+
+	QVariant getLocalValue() override
+	{
+		buildValue();
+		return VeQItemFormattedLeaf::getLocalValue();
+	}
+
+	using VeQItemFormattedLeaf::getText;
+	QString getText(bool force) override
+	{
+		buildValue();
+		return VeQItemFormattedLeaf::getText(force);
+	}
+
+protected:
+	QString formatText(QVariant const &value) override
+	{
+		if (!value.isValid() || !value.canConvert<T>())
+			return "-";
+		return Format::format(value.value<T>());
+	}
+
+private:
+	void init()
+	{
+		// discardPreview restores mValue behind our back, it signals the state change though.
+		QObject::connect(this, &VeQItem::stateChanged, this, [this] {
+			if (!mValueStale)
+				syncNative();
+		});
+	}
+
+	void buildValue()
+	{
+		if (!mValueStale)
+			return;
+
+		mValueStale = false;
+		mValue = QVariant::fromValue(mNative);
+		mLastValidValue = mValue;
+	}
+
+	void syncNative()
+	{
+		mNativeValid = mValue.isValid() && mValue.canConvert<T>();
+		mNative = mNativeValid ? mValue.value<T>() : T();
+	}
+
+	T mNative;
+	bool mNativeValid;
+	bool mValueStale;
+};
+
 class VeQItemUpdateState: public VeQItemEnum
 {
 	Q_OBJECT
@@ -1,13 +1,24 @@
 #pragma once
 
+#include <functional>
+
+#include <QElapsedTimer>
 #include <QHash>
+#include <QPointer>
+#include <QQueue>
 #include <QtDBus>
 #include <QDBusServiceWatcher>
 #include <veutil/qt/ve_qitem.hpp>
+#include <veutil/qt/ve_qitems_dbus_filter.hpp>
+#include <veutil/qt/ve_qitems_dbus_statistics.hpp>
 
 class VBusItemProxy;
 class VeQItemDbusProducer;
 class VeDbusServicePrivate;
+class VeDbusServiceDecoder;
+class VeDbusDecodedQueue;
+struct VeDbusDecodedProperty;
+typedef QVector<VeDbusDecodedProperty> VeDbusDecodedBatch;
 
 typedef QMap<QString,QString> StringMap;
 typedef QMap<QString, QVariantMap> ItemMap;
@@ -20,8 +31,18 @@ class VeQItemDbus : public VeQItem, protected QDBusContext
 	Q_OBJECT
 
 public:
+	enum BusItemProperty {
+		UnknownProperty,
+		ValueProperty,
+		TextProperty,
+		MinProperty,
+		MaxProperty,
+		DefaultProperty
+	};
+
 	VeQItemDbus(VeQItemDbusProducer *producer);
-	bool introspect();
+	~VeQItemDbus();
+	bool introspect(bool recursive = false);
 	using VeQItem::getValue;
 	QVariant getValue(bool force) override;
 	using VeQItem::getText;
@@ -33,9 +54,11 @@ public:
 	void getItemsDone();
 	void produceValue(QVariant variant, State state = Synchronized, bool forceChanged = false) override;
 	void produceText(QString text, State state = Synchronized) override;
+	void itemDeleteChild(VeQItem *child) override;
 
 protected:
 	void setParent(QObject *parent) override;
+	void watchedChanged() override;
 	QString dbusPath();
 	QString dbusServiceName();
 	bool dbusIsServiceRegistered();
@@ -46,9 +69,6 @@ protected:
 private slots:
 	void valueObtained(QDBusPendingCallWatcher *call);
 	void textObtained(QDBusPendingCallWatcher *call);
-#ifdef QT_XML_LIB
-	void introspectObtained(QDBusPendingCallWatcher *call);
-#endif
 	void onPropertiesChanged(const QVariantMap &changes);
 	void setValueDone(QDBusPendingCallWatcher *call);
 
@@ -58,12 +78,20 @@ private slots:
 
 private:
 	QVariant itemProperty(const char *name, bool force);
+	void updateDbusPath();
+	static int busItemProperty(QString const &key);
+	void applyBusItemProperty(QString const &key, QVariant value);
+	void applyDecodedProperty(int property, QVariant const &value, QString const &signature);
 	QDBusPendingCallWatcher *asyncCall(const QString &method, DbusCallback returnMethod);
 
 	void propertyObtained(const char *name, QDBusPendingCallWatcher *call);
-	void demarshallVariantForQml(QVariant &variant, QString &signature);
+	int outstandingRequests(int requests);
+	void postponeRequests(int requests);
+	void sendValue(QVariant const &value);
+	static void demarshallVariantForQml(QVariant &variant, QString &signature);
 
-	VeDbusServicePrivate *mDbusService;
+	QPointer<VeDbusServicePrivate> mDbusService;
+	QString mDbusPath;
 	QString mSignature;
 	QVariant mPendingSetValue;
 
@@ -72,8 +100,16 @@ private:
 	bool mRequestDefaultWhenOnline;
 	bool mRequestMaxWhenOnline;
 	bool mRequestMinWhenOnline;
+	int mBatchedRequests;
+	bool mChangesMatched;
+	VeQItemDbus *mPrevInService;
+	VeQItemDbus *mNextInService;
+	bool mWriteInFlight;
+	bool mHasQueuedWrite;
+	QVariant mQueuedWrite;
 
 	friend class VeDbusServicePrivate;
+	friend class VeDbusServiceDecoder;
 	friend class VeQItemDbusSettings;
 };
 
@@ -82,11 +118,24 @@ class VeQItemDbusProducer : public VeQItemProducer, protected QDBusContext
 	Q_OBJECT
 
 public:
+	/*
+	 * By default all PropertiesChanged signals of a service are received. With
+	 * SubscribeWatched only those of watched items are, see VeQItem::isWatched, so
+	 * changes of items nobody looks at aren't woken up for and decoded.
+	 */
+	enum SubscriptionMode {
+		SubscribeService,
+		SubscribeWatched
+	};
+
 	VeQItemDbusProducer(VeQItem *root, QString id, bool findVictronServices = true,
 						bool bulkInitOfNewService = true, QObject *parent = 0);
+	~VeQItemDbusProducer();
 
 	virtual bool open(const QString &address = "session", const QString &qtDbusName = "qtdbus");
 	virtual bool open(const QDBusConnection &dbusConnection);
+	bool reconnect(const QDBusConnection &dbusConnection);
+	void connectionLost();
 
 	VeQItem *createItem() override;
 	QDBusConnection &dbusConnection() { return mDbus; }
@@ -97,8 +146,96 @@ public:
 
 	bool getFindVictronServices() { return mFindVictronServices; }
 
+	// Limits the services found and the items created automatically, see VeQItemDbusFilter.
+	VeQItemDbusFilter const &getFilter() const { return mFilter; }
+	void setFilter(VeQItemDbusFilter const &filter);
+
+	SubscriptionMode getSubscriptionMode() const { return mSubscriptionMode; }
+	void setSubscriptionMode(SubscriptionMode mode);
+
+	/*
+	 * The bus daemon limits the number of match rules per connection. A service
+	 * falls back to a single match for the whole service when it has more watched
+	 * items than the per service limit or when the total limit is reached.
+	 */
+	void setMaxPathMatches(int total, int perService);
+
+	/*
+	 * Looking up the owner of services, their initial GetItems and the resync of
+	 * restarted services are pipelined, with at most this many calls outstanding at
+	 * once, 8 by default.
+	 */
+	void setMaxPendingDiscoveryCalls(int count) { mMaxDiscoveryInFlight = count; }
+
+	/*
+	 * Introspecting a tree, see VeQItemDbus::introspect, has at most this many
+	 * Introspect calls outstanding per service, 16 by default.
+	 */
+	void setMaxPendingIntrospectCalls(int count) { mMaxIntrospectInFlight = count; }
+
+	/*
+	 * Apply GetItems replies in slices of at most this duration, so large services
+	 * don't stall the event loop. Disabled (0) by default.
+	 */
+	void setBulkApplyBudget(int ms) { mBulkApplyBudget = ms; }
+
+	/*
+	 * Receive and demarshal PropertiesChanged and ItemsChanged on a separate thread,
+	 * so this thread only needs to apply the decoded values to the items.
+	 */
+	void setDecodeThread(bool enabled);
+
+	/*
+	 * A restarted service is resynced after a random delay of up to jitterMs, plus
+	 * baseMs, 3 * baseMs, 7 * baseMs etc, up to maxMs, when it keeps restarting.
+	 * Defaults are 500, 30000 and 250 ms. Without scheduling, restarted services
+	 * resync immediately, like the ones found at startup. Disabled by default.
+	 *
+	 * NOTE: till the resync, the items of the restarted service stay Offline, so for up
+	 * to maxMs + jitterMs. Writes and explicit getValue(true) / getText(true) are sent
+	 * to the service in the meantime though.
+	 */
+	void setResyncScheduling(bool enabled) { mResyncScheduling = enabled; }
+	void setResyncBackoff(int baseMs, int maxMs, int jitterMs);
+
+	/*
+	 * Services exported by VeQItemExportedDbusService keep track of what changed. When
+	 * such a service comes back after a disconnect, e.g. of a tcp connection, only the
+	 * items changed in the meantime are requested. This costs a failing call at
+	 * discovery for services not supporting it. Disabled by default.
+	 */
+	void setDeltaResync(bool enabled) { mDeltaResync = enabled; }
+
+	// Number of SetValue calls sent and of values superseded before they were sent.
+	quint64 writesSent() const { return mWritesSent; }
+	quint64 writesDropped() const { return mWritesDropped; }
+
+	// Where the time went while discovering the services, one line per service.
+	QString startupReport();
+
+	/*
+	 * Counts the signals, changes, their estimated size, decode time and calls per
+	 * service, see VeDbusServiceStatistics. Disabled by default. With a statistics
+	 * root, the numbers are also published as items below it, a subtree per service,
+	 * every intervalMs, e.g. below an item exported on the dbus itself.
+	 */
+	bool getStatistics() const { return mStatistics; }
+	void setStatistics(bool enabled);
+	void setStatisticsRoot(VeQItem *root, int intervalMs = 1000);
+	// One line per service, the services with most changed items first.
+	QString statisticsReport();
+
+signals:
+	// Emitted once, when all services present at open are discovered.
+	void startupFinished();
+	// A restarted service is synchronized again, ms is measured from its return.
+	void serviceResynced(const QString &serviceName, qint64 ms);
+	// Introspecting a service finished, nodes is the number of nodes introspected.
+	void serviceIntrospected(const QString &serviceName, int nodes);
+
 private slots:
 	void onServiceOwnerChanged(const QString &serviceName, const QString &oldOwner, const QString &newOwner);
+	void serviceNamesObtained(QDBusPendingCallWatcher *call);
 
 public:
 	bool getBulkInit() { return mBulkInitOfNewService; }
@@ -111,6 +248,44 @@ private:
 	bool mFindVictronServices;
 	bool mBulkInitOfNewService;
 	bool mAutoCreateItems;
+	SubscriptionMode mSubscriptionMode;
+	VeQItemDbusFilter mFilter;
+	int mPathMatches;
+	int mMaxPathMatches;
+	int mMaxPathMatchesPerService;
+
+	void findServices();
+	void queueDiscovery(VeDbusServicePrivate *service);
+	void discoveryCallDone();
+	void processDiscoveryQueue();
+
+	QQueue<QPointer<VeDbusServicePrivate>> mDiscoveryQueue;
+	int mDiscoveryInFlight;
+	int mMaxDiscoveryInFlight;
+	bool mListNamesPending;
+	bool mStartupFinished;
+	QElapsedTimer mStartupClock;
+	qint64 mListNamesTime;
+	int mBulkApplyBudget;
+	bool mUseDecodeThread;
+	QThread *mDecodeThread;
+	quint64 mWritesSent;
+	quint64 mWritesDropped;
+	bool mResyncScheduling;
+	int mResyncBackoffBase;
+	int mResyncBackoffMax;
+	int mResyncJitter;
+	int mResyncRestartWindow;
+	bool mDeltaResync;
+	bool mStatistics;
+	QPointer<VeQItem> mStatisticsRoot;
+	QTimer *mStatisticsTimer;
+	int mMaxIntrospectInFlight;
+
+	void publishStatistics();
+
+	friend class VeQItemDbus;
+	friend class VeDbusServicePrivate;
 };
 
 
@@ -119,10 +294,20 @@ class VeDbusServicePrivate : public QObject, protected QDBusContext
 	Q_OBJECT
 
 public:
+	enum Request {
+		RequestValue = 0x1,
+		RequestText = 0x2,
+		RequestMin = 0x4,
+		RequestMax = 0x8,
+		RequestDefault = 0x10
+	};
+
 	VeDbusServicePrivate(QString owner = QString(), QObject *parent = 0);
 	~VeDbusServicePrivate();
 
 	void attachRootItem(VeQItemDbus *serviceRoot);
+	void connectionLost();
+	void connectionChanged();
 	QString serviceName() { return mServiceRoot->id(); }
 	QString owner() { return mOwner; }
 	VeQItemDbusProducer *producer() { return mServiceRoot->producer(); }
@@ -130,23 +315,150 @@ public:
 
 	bool isRegistered() { return !mOwner.isEmpty(); }
 	bool isGetItemsActive() { return mGetItemsActive; }
+	bool isResyncPending() { return mResyncPending; }
+	void requestItem(VeQItemDbus *item, Request request);
+	// Applies a{sa{sv}}, as in ItemsChanged and the GetItems reply, returns the number of paths.
+	int applyItems(QDBusArgument const &items);
+	void itemWatchedChanged(VeQItemDbus *item);
+	void itemDestroyed(VeQItemDbus *item);
 
 protected:
 	QString dbusPath(VeQItemDbus *item);
 
 protected slots:
-	void onPropertiesChanged(const QVariantMap &changes) { handleItemProperties(message().path(), changes); }
-	void onItemsChanged(const ItemMap &items);
+	void onPropertiesChanged(const QVariantMap &changes);
+	void onItemsChanged(const QDBusMessage &message);
 	void ownerChanged(const QString &oldOwner, const QString &newOwner);
 	void itemsObtained(QDBusPendingCallWatcher *call);
+	void ownerObtained(QDBusPendingCallWatcher *call);
 
 private:
+	struct BatchedRequest {
+		QPointer<VeQItemDbus> item;
+		int requests;
+	};
+
+	struct IntrospectRequest {
+		QPointer<VeQItemDbus> item;
+		bool recursive;
+	};
+
+	struct LastValue {
+		QPointer<VeQItemDbus> item;
+		QVariant value;
+		QString text;
+		bool hasText;
+	};
+
 	void serviceRegistrationChanged(bool registered);
 	void handleItemProperties(QString const &path, const QVariantMap &changes);
+	VeQItemDbus *itemForPath(QString const &path);
+	int applyItems(QDBusMessage const &message);
+	void applyItemsChanged(QDBusMessage const &message);
+	void applyItem(QDBusArgument const &items);
+	bool itemsArgument(QDBusMessage const &message, QDBusArgument &items);
+	void applyBatch(QDBusMessage const &reply, QList<BatchedRequest> const &batch);
+	void itemsApplied();
+	void applyItemsChunk(int generation);
+	void stopChunkedApply();
+	QObject *changesReceiver();
+	const char *propertiesChangedSlot();
+	void applyDecoded();
+	void applyDecodedBatch(VeDbusDecodedBatch const &batch);
+	void flushRequests();
+	void requestBatch(QString const &path, QList<BatchedRequest> const &batch);
+	static QString commonAncestor(QList<BatchedRequest> const &batch);
+	void batchObtained(QDBusPendingCallWatcher *call, QString const &path, QList<BatchedRequest> const &batch);
+	void requestIndividually(VeQItemDbus *item, int requests);
+	void matchPath(QString const &path, bool match);
+	void matchService();
+	void matchPropertiesChanged(QString const &path, bool match);
+	void itemsChangedReceived();
+	void forgetItemsChanged();
+	void restorePropertiesChanged();
+	void forgetItems(VeQItemDbus *item);
+	void linkItem(VeQItemDbus *item);
+	void unlinkItem(VeQItemDbus *item);
+	template<typename F> void forEachItem(F const &f);
+	void startDiscoveryCall();
+	void scheduleResync();
+	void resyncDone();
+	void sendGetItems();
+	void itemsSinceObtained(QDBusMessage const &reply);
+	void markItemsGeneration(quint64 generation);
+	void itemsGenerationMarked(int mark);
+	quint64 itemsGenerationSeen();
+	void restoreValues();
+	void rememberValues();
+	void trackCall(QDBusPendingCallWatcher *watcher);
+	void introspect(VeQItemDbus *item, bool recursive);
+	void processIntrospectQueue();
+	void introspectObtained(QDBusPendingCallWatcher *call, IntrospectRequest const &request);
+	static QStringList childNodes(QString const &introspection);
+	VeDbusServiceStatistics statistics();
+	QDBusPendingCallWatcher *asyncCall(QDBusMessage const &msg, void (VeDbusServicePrivate::*slot)(QDBusPendingCallWatcher *));
 
 	QString mOwner;
 	VeQItemDbus *mServiceRoot;
 	bool mGetItemsActive;
+	QList<QPointer<VeQItemDbus>> mRequestBatch;
+	bool mRequestFlushScheduled;
+	bool mBulkRequestsSupported;
+	bool mSubtreeRequestsSupported;
+	bool mServiceMatched;
+	bool mItemsChangedSeen;
+	QHash<VeQItemDbus *, QString> mPathMatches;
+	QHash<QString, VeQItemDbus *> mItemsByPath;
+	QSet<QString> mFilteredPaths;
+
+	bool mOwnerLookupPending;
+	bool mGetItemsSent;
+
+	// Timing of the last discovery, in ms since the producer was opened.
+	qint64 mDiscoveryQueuedAt;
+	qint64 mDiscoveryStartedAt;
+	qint64 mOwnerObtainedAt;
+	qint64 mItemsObtainedAt;
+	qint64 mItemsAppliedAt;
+	int mItemsObtained;
+
+	VeQItemDbus *mFirstItem;
+	VeQItemDbus *mLastItem;
+	VeQItemDbus *mIterationNext;
+	bool mIterating;
+
+	QDBusArgument mBulkItems;
+	bool mBulkApplying;
+	int mBulkGeneration;
+	QList<std::function<void()>> mDeferredUpdates;
+
+	QPointer<VeDbusServiceDecoder> mDecoder;
+	QSharedPointer<VeDbusDecodedQueue> mDecodedQueue;
+
+	bool mWasRegistered;
+	bool mResyncPending;
+	bool mResyncing;
+	int mResyncGeneration;
+	int mRestarts;
+	qint64 mResyncScheduledAt;
+	int mResyncCount;
+	qint64 mLastResyncDuration;
+
+	VeDbusServiceStatistics mStats;
+
+	QQueue<IntrospectRequest> mIntrospectQueue;
+	int mIntrospectInFlight;
+	int mIntrospectedNodes;
+
+	bool mItemsSinceSupported;
+	bool mItemsSinceSent;
+	quint64 mItemsGeneration;
+	bool mItemsGenerationMarked;
+	int mItemsMark;
+	quint64 mItemsChangedApplied;
+	quint64 mItemsChangedBase;
+	QList<LastValue> mLastValues;
+	int mDeltaResyncCount;
 
 	void getItems();
 
@@ -163,10 +475,14 @@ public:
 	VeQItemDbusSettings(VeQItem *parent, QString id);
 
 	bool addSettings(VeQItemSettingsInfo const &info) override;
+	// Sends AddSettings without blocking, done is not called when the root is destructed first.
+	void addSettingsAsync(VeQItemSettingsInfo const &info,
+						  std::function<void (QList<VeQItem *> const &items)> const &done) override;
 
 private:
+	QDBusMessage createAddSettings(VeQItemSettingsInfo const &settingsInfo);
 	QDBusMessage sendAddSettings(VeQItemSettingsInfo const &settingsInfo);
-	bool handleAddSettingsReply(QDBusMessage &reply);
+	static bool handleAddSettingsReply(VeQItem *root, QDBusMessage const &reply, QSet<VeQItem *> *added = nullptr);
 
 	QDBusConnection &mConn;
 };
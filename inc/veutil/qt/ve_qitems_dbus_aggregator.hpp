@@ -0,0 +1,93 @@
+#pragma once
+
+#include <QHash>
+#include <QList>
+#include <QObject>
+#include <QStringList>
+#include <QTimer>
+
+#include <veutil/qt/ve_qitem.hpp>
+
+class QThread;
+class VeQItemDbusProducer;
+
+/*
+ * Mounts the services of several buses under one root, e.g. those of multiple GX
+ * devices over tcp, each below root/<id>. Every bus has its own VeQItemDbusProducer.
+ *
+ * Connecting to a bus blocks, for up to tens of seconds when a host doesn't
+ * respond, so every bus connects on a thread of its own and the producer is opened
+ * once connected. A dead host therefore doesn't stall the others nor the event loop.
+ * The items themselves are part of one tree and stay in the thread of the root, the
+ * messages are already read and written by the internal thread of QtDBus.
+ *
+ * Lost connections are noticed within the health check interval and are reconnected
+ * with an exponential backoff. The items stay, their services go offline and come
+ * back once they are found again, see VeQItemDbusProducer::reconnect.
+ *
+ * Example:
+ *
+ * VeQItemDbusAggregator *buses = new VeQItemDbusAggregator(root);
+ * buses->addBus("gx1", "tcp:host=192.168.1.10,port=78");
+ * buses->addBus("gx2", "tcp:host=192.168.1.11,port=78");
+ */
+class VE_QITEM_EXPORT VeQItemDbusAggregator : public QObject
+{
+	Q_OBJECT
+
+public:
+	VeQItemDbusAggregator(VeQItem *root, QObject *parent = 0);
+	// Waits for connects which are still in progress.
+	~VeQItemDbusAggregator();
+
+	/*
+	 * Adds a bus, address like VeQItemDbusProducer::open. The producer is returned so
+	 * it can be configured before it is opened, which happens once connected. Adding
+	 * an id again returns the producer of the existing bus.
+	 */
+	VeQItemDbusProducer *addBus(QString const &id, QString const &address, bool findVictronServices = true,
+								bool bulkInitOfNewService = true);
+	void removeBus(QString const &id);
+
+	VeQItemDbusProducer *producer(QString const &id) const;
+	bool isConnected(QString const &id) const;
+	QStringList buses() const { return mBuses.keys(); }
+
+	// Reconnect attempts start after minMs and double till maxMs, 1 s and 60 s by default.
+	void setReconnectBackoff(int minMs, int maxMs);
+	void setHealthCheckInterval(int ms) { mHealthTimer.setInterval(ms); }
+
+signals:
+	void busConnected(QString const &id);
+	void busDisconnected(QString const &id);
+	// The next attempt is made after retryMs.
+	void busConnectFailed(QString const &id, int retryMs);
+
+private:
+	struct Bus
+	{
+		QString id;
+		QString address;
+		VeQItemDbusProducer *producer;
+		QThread *thread;
+		QObject *connector;
+		QString connectionName;
+		int generation;
+		int backoff;
+		bool connecting;
+		bool connected;
+		bool opened;
+	};
+
+	void connectBus(Bus *bus);
+	void busConnectResult(QString const &id, int generation, bool connected);
+	void scheduleReconnect(Bus *bus);
+	void checkConnections();
+
+	VeQItem *mRoot;
+	QHash<QString, Bus *> mBuses;
+	QList<QThread *> mRetiredThreads;
+	QTimer mHealthTimer;
+	int mBackoffMin;
+	int mBackoffMax;
+};
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <QHash>
+#include <QList>
+#include <QRegularExpression>
+#include <QStringList>
+
+#include <veutil/qt/ve_qitem.hpp>
+
+/*
+ * Limits which services a VeQItemDbusProducer imports and, with auto created items,
+ * which paths of them. Processes only interested in e.g. the soc of the batteries
+ * and the grid power then don't hold complete trees of unrelated services.
+ *
+ * Patterns containing '*', '?' or '[' are globs matching the complete name or path.
+ * Other patterns match as prefix on a boundary, so "com.victronenergy.battery" matches
+ * "com.victronenergy.battery.ttyO1", but not "com.victronenergy.batterymonitor", and
+ * "/Dc/0" matches "/Dc/0/Voltage". Without include patterns everything is included,
+ * excludes take precedence over includes.
+ *
+ * Path rules are per service type, the part after "com.victronenergy.", e.g. "battery".
+ * Rules for type "*" apply to services without rules of their own.
+ *
+ * Example:
+ *
+ * VeQItemDbusFilter filter;
+ * filter.includeServices({"com.victronenergy.battery", "com.victronenergy.grid"});
+ * filter.includePaths("battery", {"/Soc"});
+ * filter.includePaths("grid", {"/Ac/Power"});
+ * producer->setFilter(filter);
+ */
+class VE_QITEM_EXPORT VeQItemDbusFilter
+{
+public:
+	void includeServices(QStringList const &patterns) { addPatterns(mServices.include, patterns, '.'); }
+	void excludeServices(QStringList const &patterns) { addPatterns(mServices.exclude, patterns, '.'); }
+	void includePaths(QString const &serviceType, QStringList const &patterns);
+	void excludePaths(QString const &serviceType, QStringList const &patterns);
+
+	bool isEmpty() const { return mServices.isEmpty() && mPaths.isEmpty(); }
+	bool acceptService(QString const &serviceName) const;
+	// Paths are as on the bus, so with a leading slash.
+	bool acceptPath(QString const &serviceName, QString const &path) const;
+
+	static QString serviceType(QString const &serviceName);
+
+private:
+	struct Pattern {
+		QString prefix;
+		QRegularExpression glob;
+		QChar boundary;
+
+		bool matches(QString const &str) const;
+	};
+
+	struct Rules {
+		QList<Pattern> include;
+		QList<Pattern> exclude;
+
+		bool isEmpty() const { return include.isEmpty() && exclude.isEmpty(); }
+		bool accept(QString const &str) const;
+	};
+
+	static QRegularExpression globToRegularExpression(QString const &pattern);
+	static void addPatterns(QList<Pattern> &list, QStringList const &patterns, QChar boundary);
+	Rules const *pathRules(QString const &serviceName) const;
+
+	Rules mServices;
+	QHash<QString, Rules> mPaths;
+};
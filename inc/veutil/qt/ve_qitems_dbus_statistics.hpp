@@ -0,0 +1,34 @@
+#pragma once
+
+#include <QVariant>
+#include <QVector>
+
+/*
+ * Traffic of a single service as seen by a VeQItemDbusProducer, see
+ * VeQItemDbusProducer::setStatistics. The size of the changes is an estimate
+ * based on the paths, keys and values received, not the size of the messages on
+ * the bus. Decode time includes applying the changes to the items.
+ */
+class VeDbusServiceStatistics
+{
+public:
+	quint64 itemsChangedSignals = 0;
+	quint64 propertiesChangedSignals = 0;
+	quint64 itemsChanged = 0;
+	quint64 bytes = 0;
+	qint64 decodeNs = 0;
+	int pendingCalls = 0;
+	quint64 calls = 0;
+
+	// Call latencies in us, of the most recent calls. Returns -1 without calls.
+	void addLatency(qint64 us);
+	qint64 latencyPercentile(int percentile) const;
+
+	static int estimatedSize(QVariant const &value);
+
+private:
+	static const int latencySamples = 256;
+
+	QVector<qint64> mLatencies;
+	int mNextLatency = 0;
+};
@@ -2,6 +2,7 @@
 #include <QProcess>
 
 #include <veutil/qt/canbus_interfaces.hpp>
+#include <veutil/qt/ve_qitem_poll_scheduler.hpp>
 
 CanBusProfile::CanBusProfile(int bitrate, QObject *parent) :
 	QObject(parent),
@@ -98,13 +99,14 @@ CanBusProfiles::CanBusProfiles(VeQItemSettings *settings, VeQItem *service, QStr
 	mInterfaceItem = service->itemGetOrCreate("CanBus/Interface/" + interface);
 	mInterfaceItem->itemAddChild("Statistics", new VeQItemCanStats(interface));
 
-	connect(&mTimer, &QTimer::timeout, this, &CanBusProfiles::onPollTimer);
-	onPollTimer();
-	mTimer.start(60000);
+	// The state of the interface is also needed when nobody watches it locally, hence always poll.
+	VeQItemPollScheduler::instance()->add(mInterfaceItem, [this](VeQItem *) { poll(); }, 60000,
+										  VeQItemPollScheduler::Alarm, VeQItemPollScheduler::PollAlways);
 }
 
 CanBusProfiles::~CanBusProfiles()
 {
+	VeQItemPollScheduler::instance()->remove(mInterfaceItem);
 	mInterfaceItem->itemDelete();
 }
 
@@ -209,7 +211,7 @@ void CanBusProfiles::checkFailed()
 	mInterfaceItem->itemGetOrCreateAndProduce("Failed", canState);
 }
 
-void CanBusProfiles::onPollTimer()
+void CanBusProfiles::poll()
 {
 	checkSpiStats();
 	checkFailed();
@@ -261,12 +263,28 @@ void CanBusService::dbusItemChanged(VeQItem *item, QVariant var)
 	checkStart();
 }
 
+VeQItemCanStats::VeQItemCanStats(QString const &interface) :
+	VeQItemExportedLeaf(),
+	mInterface(interface)
+{
+}
+
+/*
+ * Only obtained when asked for, the exporter always listens to the item, so polling
+ * while watched would run ip forever. Reads in quick succession, e.g. GetValue and
+ * GetText or several consumers, share a single run.
+ */
 QVariant VeQItemCanStats::getValue()
 {
+	if (mLastRun.isValid() && !mLastRun.hasExpired(1000))
+		return mStats;
+
 	QProcess process;
 
 	process.start("ip", QStringList() << "-json" << "-details" << "-statistics" << "link" << "show" << mInterface);
 	process.waitForFinished();
+	mLastRun.start();
+	mStats = QString::fromUtf8(process.readAllStandardOutput()).trimmed();
 
-	return QString::fromUtf8(process.readAllStandardOutput()).trimmed();
+	return mStats;
 }
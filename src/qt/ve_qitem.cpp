@@ -15,7 +15,8 @@ VeQItem::VeQItem(VeQItemProducer *producer, QObject *parent) :
 	mIsLeaf(false),
 	mWatched(false),
 	mSeen(false),
-	mSensitive(false)
+	mSensitive(false),
+	mAliases(nullptr)
 {
 }
 
@@ -35,6 +36,12 @@ VeQItem::~VeQItem()
 	// The default QObject destructor runs the otherway around and then partially destucted
 	// objects are emitting signals.
 	forAllChildrenSafe([](VeQItem *child) { child->itemDelete(); });
+
+	if (mAliases) {
+		for (VeQItemProxy *alias: *mAliases)
+			alias->mSrcItem = nullptr;
+		delete mAliases;
+	}
 }
 
 void VeQItem::setParent(QObject *parent)
@@ -77,19 +84,37 @@ void VeQItem::discardPreview()
 	mValue = mValueWhilePreviewing;
 	mTextState = mTextStateWhilePreviewing;
 	mText = mTextWhilePreviewing;
-	emit valueChanged(mValue);
+	notifyValueChanged(mValue);
 	emit stateChanged(mState);
-	emit textChanged(mText);
+	notifyTextChanged(mText);
 	emit textStateChanged(mTextState);
 }
 
 void VeQItem::updateWatched()
 {
-	bool watched = receivers(SIGNAL(valueChanged(QVariant))) != 0;
+	bool watched = isWatched();
+
 	if (mWatched == watched)
 		return;
 	mWatched = watched;
 	watchedChanged();
+	emit watchedStateChanged();
+}
+
+bool VeQItem::isWatched() const
+{
+	if (receivers(SIGNAL(valueChanged(QVariant))) != 0)
+		return true;
+
+	// Receivers of aliases are notified by this item directly, so count them as well.
+	if (mAliases) {
+		for (VeQItemProxy *alias: *mAliases) {
+			if (alias->receivers(SIGNAL(valueChanged(QVariant))) != 0)
+				return true;
+		}
+	}
+
+	return false;
 }
 
 void VeQItem::receiverDestroyed(QObject *obj)
@@ -151,6 +176,15 @@ void VeQItem::itemDeleteChild(VeQItem *child)
 	child->deleteLater();
 }
 
+// removes the child without deleting it, e.g. to add it elsewhere
+void VeQItem::itemRemoveChild(VeQItem *child)
+{
+	emit childAboutToBeRemoved(child);
+	mChildren.remove(child->mId);
+	emit childRemoved(child);
+	child->setParent(nullptr);
+}
+
 // deletes the item and removes it from its parent
 void VeQItem::itemDelete()
 {
@@ -234,7 +268,7 @@ void VeQItem::produceValue(QVariant variant, State state, bool forceChanged)
 	if (stateIsChanged)
 		emit stateChanged(state);
 	if (valueIsChanged)
-		emit valueChanged(variant);
+		notifyValueChanged(variant);
 }
 
 void VeQItem::produceText(QString text, VeQItem::State state)
@@ -264,7 +298,7 @@ void VeQItem::produceText(QString text, VeQItem::State state)
 	if (stateIsChanged)
 		emit textStateChanged(state);
 	if (textIsChanged)
-		emit textChanged(text);
+		notifyTextChanged(text);
 }
 
 QString VeQItem::id() const
@@ -397,7 +431,74 @@ void VeQItem::itemProduceProperty(const char *name, const QVariant &value, VeQIt
 	mPropertyState[name] = state;
 	setProperty(name, value);
 	if (changed)
-		emit dynamicPropertyChanged(name, value);
+		notifyPropertyChanged(name, value);
+}
+
+bool VeQItem::hasTextReceivers()
+{
+	static const QMetaMethod textChangedSignal = QMetaMethod::fromSignal(&VeQItem::textChanged);
+
+	if (isSignalConnected(textChangedSignal))
+		return true;
+
+	if (mAliases) {
+		for (VeQItemProxy *alias: *mAliases) {
+			if (alias->isSignalConnected(textChangedSignal))
+				return true;
+		}
+	}
+
+	return false;
+}
+
+/*
+ * Aliases share the storage of this item, so their receivers are notified from here
+ * instead of relaying the signal through the alias, see VeQItemProxy::Alias. The list
+ * is copied, since a receiver might remove an alias.
+ */
+void VeQItem::notifyValueChanged(QVariant const &value)
+{
+	emit valueChanged(value);
+	if (mAliases) {
+		QList<VeQItemProxy *> const aliases = *mAliases;
+		for (VeQItemProxy *alias: aliases)
+			emit alias->valueChanged(value);
+	}
+
+	notifyValueInvalidated();
+}
+
+void VeQItem::notifyValueInvalidated()
+{
+	emit valueInvalidated();
+	if (!mAliases)
+		return;
+
+	QList<VeQItemProxy *> const aliases = *mAliases;
+	for (VeQItemProxy *alias: aliases)
+		emit alias->valueInvalidated();
+}
+
+void VeQItem::notifyTextChanged(QString const &text)
+{
+	emit textChanged(text);
+	if (!mAliases)
+		return;
+
+	QList<VeQItemProxy *> const aliases = *mAliases;
+	for (VeQItemProxy *alias: aliases)
+		emit alias->textChanged(text);
+}
+
+void VeQItem::notifyPropertyChanged(char const *name, QVariant const &value)
+{
+	emit dynamicPropertyChanged(name, value);
+	if (!mAliases)
+		return;
+
+	QList<VeQItemProxy *> const aliases = *mAliases;
+	for (VeQItemProxy *alias: aliases)
+		emit alias->dynamicPropertyChanged(name, value);
 }
 
 // returns the index in the parents it child ids.
@@ -495,14 +596,51 @@ VeQItem *VeQItems::getRoot()
 	return &theRoot;
 }
 
-VeQItemProxy::VeQItemProxy(VeQItem *srcItem) :
+VeQItemProxy::VeQItemProxy(VeQItem *srcItem, Mode mode) :
 	VeQItem(nullptr), // NOTE: children cannot be created!
-	mSrcItem(srcItem)
+	mSrcItem(srcItem),
+	mMode(mode)
 {
 	mIsLeaf = true;
-	connect(mSrcItem, &VeQItem::valueChanged, this, &VeQItem::valueChanged);
-	connect(mSrcItem, &VeQItem::textChanged, this, &VeQItem::textChanged);
-	connect(mSrcItem, &VeQItem::dynamicPropertyChanged, this, &VeQItem::dynamicPropertyChanged);
+
+	if (mMode == Relay) {
+		connect(mSrcItem, &VeQItem::valueChanged, this, &VeQItem::valueChanged);
+		connect(mSrcItem, &VeQItem::valueInvalidated, this, &VeQItem::valueInvalidated);
+		connect(mSrcItem, &VeQItem::textChanged, this, &VeQItem::textChanged);
+		connect(mSrcItem, &VeQItem::dynamicPropertyChanged, this, &VeQItem::dynamicPropertyChanged);
+		return;
+	}
+
+	// Any proxy returns the values of its source, so alias the original item directly.
+	// That also makes sure a relaying proxy in the chain doesn't swallow notifications.
+	// An alias whose source is gone is the end of the chain.
+	while (VeQItemProxy *proxy = qobject_cast<VeQItemProxy *>(mSrcItem)) {
+		if (!proxy->mSrcItem)
+			break;
+		mSrcItem = proxy->mSrcItem;
+	}
+
+	if (!mSrcItem)
+		return;
+
+	if (!mSrcItem->mAliases)
+		mSrcItem->mAliases = new QList<VeQItemProxy *>();
+	mSrcItem->mAliases->append(this);
+}
+
+VeQItemProxy::~VeQItemProxy()
+{
+	if (mMode != Alias || !mSrcItem)
+		return;
+
+	mSrcItem->mAliases->removeOne(this);
+	mSrcItem->updateWatched();
+}
+
+void VeQItemProxy::watchedChanged()
+{
+	if (mMode == Alias && mSrcItem)
+		mSrcItem->updateWatched();
 }
 
 #pragma GCC diagnostic push
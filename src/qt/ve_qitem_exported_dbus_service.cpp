@@ -1,18 +1,33 @@
+#include <algorithm>
+
 #include <QDBusArgument>
 #include <QDBusMessage>
 #include <QDBusVariant>
 #include <QDebug>
+#include <QRandomGenerator>
+#include <QVector>
 #include <veutil/qt/ve_qitem.hpp>
 #include "ve_qitem_exported_dbus_service.hpp"
 
 Q_DECLARE_METATYPE(QList<int>)
 Q_DECLARE_METATYPE(StringMap)
 
+// The number of changed paths remembered for GetItemsSince, see compactHistory.
+static const int maxChangeHistory = 1024;
+
+/*
+ * Every ItemsChanged increments the generation. The upper 32 bits are random, so a
+ * generation obtained from a previous instance of the service is never mistaken for
+ * one of this instance.
+ */
 VeQItemExportedDbusService::VeQItemExportedDbusService(const QDBusConnection &connection, VeQItem *root,
 												   QObject *parent):
 	QDBusVirtualObject(parent),
 	mConnection(connection),
-	mRoot(root)
+	mRoot(root),
+	mGeneration(quint64(QRandomGenerator::global()->generate() | 1) << 32),
+	mCompactedUpTo(mGeneration),
+	mTrackChanges(false)
 {
 	Q_ASSERT(root != 0);
 	connectItem(root);
@@ -69,6 +84,7 @@ QString VeQItemExportedDbusService::introspect(const QString &path) const
 				"    </method>\n"
 				"%1"
 				"%2"
+				"%3"
 				"  </interface>\n")
 			.arg(!item->hasChildren()
 				 ? "    <method name=\"SetValue\">\n"
@@ -85,10 +101,18 @@ QString VeQItemExportedDbusService::introspect(const QString &path) const
 				   "      <arg direction=\"out\" type=\"v\" name=\"value\"/>\n"
 				   "    </method>\n"
 				 : "",
-			path == "/"
+			item->hasChildren() || path == "/"
 				 ? "    <method name=\"GetItems\">\n"
 				   "      <arg direction=\"out\" type=\"a{sa{sv}}\" name=\"items\"/>\n"
 				   "    </method>\n"
+				 : "",
+			path == "/"
+				 ? "    <method name=\"GetItemsSince\">\n"
+				   "      <arg direction=\"in\" type=\"t\" name=\"generation\"/>\n"
+				   "      <arg direction=\"out\" type=\"a{sa{sv}}\" name=\"items\"/>\n"
+				   "      <arg direction=\"out\" type=\"t\" name=\"generation\"/>\n"
+				   "      <arg direction=\"out\" type=\"b\" name=\"all\"/>\n"
+				   "    </method>\n"
 				   "    <signal name=\"ItemsChanged\">\n"
 				   "      <arg direction=\"out\" type=\"a{sa{sv}}\" name=\"changes\"/>\n"
 				   "    </signal>\n"
@@ -116,8 +140,10 @@ bool VeQItemExportedDbusService::handleMessage(const QDBusMessage &message,
 			return handleGetValue(message, connection, item);
 		if (member == "GetText")
 			return handleGetText(message, connection, item);
-		if (member == "GetItems" && message.path() == "/")
-			return handleGetItems(message, connection);
+		if (member == "GetItems" && (item->hasChildren() || item == mRoot))
+			return handleGetItems(message, connection, item);
+		if (member == "GetItemsSince" && item == mRoot)
+			return handleGetItemsSince(message, connection);
 
 		if (!item->isLeaf())
 			return false;
@@ -208,34 +234,142 @@ bool VeQItemExportedDbusService::handleGetDefault(const QDBusMessage &message, c
 	return connection.send(reply);
 }
 
+/*
+ * GetItems on a node returns the items below it, so a consumer only interested in a
+ * part of the service doesn't need to get all of it. The paths are always relative
+ * to the root of the service, like in ItemsChanged.
+ */
 bool VeQItemExportedDbusService::handleGetItems(const QDBusMessage &message,
-											  const QDBusConnection &connection)
+											  const QDBusConnection &connection, VeQItem *node)
 {
 	ItemMap items;
 
-	mRoot->foreachParentFirst([&items,this](VeQItem *item){
-		if (!item->hasChildren()) {
-			QMap<QString, QVariant> m;
-			m.insert("Value", denormalizeVariant(item->getValue()));
-			m.insert("Text", item->getText());
+	addItems(node, items);
+	QDBusMessage reply = message.createReply(QVariant::fromValue(items));
 
-			QVariant v;
-			v = item->itemProperty("min");
-			if (v.isValid())
-				m.insert("Min", v); // No need to denormalize as v is valid
-			v = item->itemProperty("max");
-			if (v.isValid())
-				m.insert("Max", v);
-			v = item->itemProperty("defaultValue");
-			if (v.isValid())
-				m.insert("Default", v);
-			items.insert(item->getRelId(mRoot), m);
+	return connection.send(reply);
+}
+
+/*
+ * Returns the items changed after the given generation, and the current generation
+ * to pass the next time. After a short disconnect, a consumer only needs these
+ * instead of all items. When the changes since then are no longer known, e.g.
+ * since the service restarted, the history was compacted or this is the first
+ * request, all items are returned and the last argument is true. Items removed in the meantime are returned invalid.
+ */
+bool VeQItemExportedDbusService::handleGetItemsSince(const QDBusMessage &message,
+												   const QDBusConnection &connection)
+{
+	QList<QVariant> args = message.arguments();
+	if (args.size() != 1 || args.first().userType() != QMetaType::ULongLong) {
+		QDBusMessage reply = message.createErrorReply(QDBusError::InvalidArgs,
+													  "Expected a generation");
+		return connection.send(reply);
+	}
+
+	quint64 since = args.first().toULongLong();
+	bool all = !mTrackChanges || (since >> 32) != (mGeneration >> 32) ||
+			since < mCompactedUpTo || since > mGeneration;
+
+	// Changes are only remembered once a consumer asks for them.
+	if (!mTrackChanges) {
+		mTrackChanges = true;
+		mCompactedUpTo = mGeneration;
+	}
+	ItemMap items;
+
+	if (all) {
+		addItems(mRoot, items);
+	} else {
+		for (auto it = mChangedAt.constBegin(); it != mChangedAt.constEnd(); ++it) {
+			if (it.value() <= since)
+				continue;
+			VeQItem *item = mRoot->itemGet(it.key());
+			if (!item)
+				items.insert(it.key(), removedProperties());
+			else if (!item->hasChildren())
+				items.insert(it.key(), itemProperties(item));
 		}
+	}
+
+	QDBusMessage reply = message.createReply(QList<QVariant>() << QVariant::fromValue(items)
+											 << QVariant::fromValue(mGeneration) << all);
+	return connection.send(reply);
+}
+
+void VeQItemExportedDbusService::addItems(VeQItem *node, ItemMap &items)
+{
+	node->foreachParentFirst([&items,this](VeQItem *item){
+		if (!item->hasChildren())
+			items.insert(item->getRelId(mRoot), itemProperties(item));
 	});
+}
 
-	QDBusMessage reply = message.createReply(QVariant::fromValue(items));
+QVariantMap VeQItemExportedDbusService::itemProperties(VeQItem *item)
+{
+	QMap<QString, QVariant> m;
+	m.insert("Value", denormalizeVariant(item->getValue()));
+	m.insert("Text", item->getText());
+
+	QVariant v;
+	v = item->itemProperty("min");
+	if (v.isValid())
+		m.insert("Min", v); // No need to denormalize as v is valid
+	v = item->itemProperty("max");
+	if (v.isValid())
+		m.insert("Max", v);
+	v = item->itemProperty("defaultValue");
+	if (v.isValid())
+		m.insert("Default", v);
+
+	return m;
+}
 
-	return connection.send(reply);
+// A removed item is reported as invalid, like the consumer has it after an ItemsChanged.
+QVariantMap VeQItemExportedDbusService::removedProperties()
+{
+	QVariantMap m;
+	m.insert("Value", denormalizeVariant(QVariant()));
+	m.insert("Text", QString());
+	return m;
+}
+
+/*
+ * Changes are remembered per path with the generation of the ItemsChanged they are
+ * sent with. Only the last change of a path is needed, so the history is at most as
+ * large as the service. For large services, the older half is forgotten once it
+ * exceeds maxChangeHistory, consumers which are behind that get all items instead.
+ */
+void VeQItemExportedDbusService::compactHistory()
+{
+	QVector<quint64> generations;
+	generations.reserve(mChangedAt.size());
+	for (quint64 generation: std::as_const(mChangedAt))
+		generations.append(generation);
+
+	auto middle = generations.begin() + generations.size() / 2;
+	std::nth_element(generations.begin(), middle, generations.end());
+	quint64 cutoff = *middle;
+
+	for (auto it = mChangedAt.begin(); it != mChangedAt.end();) {
+		if (it.value() <= cutoff)
+			it = mChangedAt.erase(it);
+		else
+			++it;
+	}
+
+	mCompactedUpTo = qMax(mCompactedUpTo, cutoff);
+}
+
+// Remembers a change of path for GetItemsSince, it is sent with the next ItemsChanged.
+void VeQItemExportedDbusService::recordChange(QString const &path)
+{
+	if (!mTrackChanges)
+		return;
+
+	mChangedAt.insert(path, mGeneration + 1);
+	if (mChangedAt.size() > maxChangeHistory)
+		compactHistory();
 }
 
 void VeQItemExportedDbusService::addPending(VeQItem *item, VeQItem::Properties property)
@@ -273,7 +407,9 @@ void VeQItemExportedDbusService::processPending()
 		if (flags.testFlag(VeQItem::Max))
 			m.insert("Max", denormalizeVariant(item->itemProperty("max")));
 
-		items.insert(item->getRelId(mRoot), m);
+		QString path = item->getRelId(mRoot);
+		recordChange(path);
+		items.insert(path, m);
 	}
 
 	QDBusMessage message = QDBusMessage::createSignal("/", "com.victronenergy.BusItem", "ItemsChanged");
@@ -284,12 +420,16 @@ void VeQItemExportedDbusService::processPending()
 	}
 
 	mPendingChanges.clear();
+	mGeneration++;
 }
 
 void VeQItemExportedDbusService::connectItem(VeQItem *item)
 {
-	connect(item, &VeQItem::valueChanged, this, &VeQItemExportedDbusService::onValueChanged);
-	connect(item, &VeQItem::textChanged, this, &VeQItemExportedDbusService::onTextChanged);
+	// The value is read when sending it, listening to valueChanged would make the item watched.
+	connect(item, &VeQItem::valueInvalidated, this, &VeQItemExportedDbusService::onValueChanged);
+	// A derived text is sent along with the value, listening to it would format it eagerly.
+	if (!item->hasDerivedText())
+		connect(item, &VeQItem::textChanged, this, &VeQItemExportedDbusService::onTextChanged);
 	connect(item, &VeQItem::dynamicPropertyChanged,
 			this, &VeQItemExportedDbusService::onDynamicPropertyChanged);
 
@@ -311,6 +451,14 @@ void VeQItemExportedDbusService::disconnectItem(VeQItem *item)
 void VeQItemExportedDbusService::onChildAdded(VeQItem *child)
 {
 	connectItem(child);
+
+	// New items aren't sent with ItemsChanged, but are changed for GetItemsSince.
+	if (!mTrackChanges)
+		return;
+	child->foreachParentFirst([this](VeQItem *item) {
+		if (!item->hasChildren())
+			recordChange(item->getRelId(mRoot));
+	});
 }
 
 void VeQItemExportedDbusService::onChildAboutToBeRemoved(VeQItem *child)
@@ -318,12 +466,26 @@ void VeQItemExportedDbusService::onChildAboutToBeRemoved(VeQItem *child)
 	// flush to make sure there are no dangling pointers in the queue
 	processPending();
 	disconnectItem(child);
+
+	// Removals are changes for GetItemsSince as well, see handleGetItemsSince.
+	if (!mTrackChanges)
+		return;
+	child->foreachParentFirst([this](VeQItem *item) {
+		if (!item->hasChildren())
+			recordChange(item->getRelId(mRoot));
+	});
 }
 
 void VeQItemExportedDbusService::onValueChanged()
 {
 	VeQItem *item = static_cast<VeQItem *>(sender());
-	addPending(item, VeQItem::Value);
+	VeQItem::Properties properties = VeQItem::Value;
+
+	// The text is only formatted once per ItemsChanged this way, see VeQItem::hasDerivedText.
+	if (item->hasDerivedText())
+		properties |= VeQItem::Text;
+
+	addPending(item, properties);
 }
 
 void VeQItemExportedDbusService::onTextChanged()
@@ -2,6 +2,7 @@
 
 #include <QDBusConnection>
 #include <QDBusVirtualObject>
+#include <QHash>
 #include <QList>
 #include <QVariantMap>
 
@@ -44,7 +45,14 @@ private:
 						VeQItem *item);
 	bool handleGetDefault(const QDBusMessage &message, const QDBusConnection &connection,
 						VeQItem *item);
-	bool handleGetItems(const QDBusMessage &message, const QDBusConnection &connection);
+	bool handleGetItems(const QDBusMessage &message, const QDBusConnection &connection,
+						VeQItem *node);
+	bool handleGetItemsSince(const QDBusMessage &message, const QDBusConnection &connection);
+	void addItems(VeQItem *node, ItemMap &items);
+	QVariantMap itemProperties(VeQItem *item);
+	static QVariantMap removedProperties();
+	void compactHistory();
+	void recordChange(QString const &path);
 
 	void addPending(VeQItem *item, VeQItem::Properties property);
 	Q_INVOKABLE void processPending();
@@ -88,4 +96,8 @@ private:
 	QDBusConnection mConnection;
 	VeQItem *mRoot;
 	QList<QPair<VeQItem *, VeQItem::Properties>> mPendingChanges;
+	quint64 mGeneration;
+	quint64 mCompactedUpTo;
+	QHash<QString, quint64> mChangedAt;
+	bool mTrackChanges;
 };
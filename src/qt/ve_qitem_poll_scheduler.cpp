@@ -0,0 +1,180 @@
+#include <algorithm>
+
+#include <QCoreApplication>
+#include <QPointer>
+#include <QRandomGenerator>
+
+#include <veutil/qt/ve_qitem_poll_scheduler.hpp>
+
+VeQItemPollScheduler::VeQItemPollScheduler(QObject *parent) :
+	QObject(parent),
+	mCoalescingWindow(100),
+	mMaxPollsPerWakeup(0)
+{
+	mClock.start();
+	mTimer.setSingleShot(true);
+	mTimer.setTimerType(Qt::CoarseTimer);
+	connect(&mTimer, &QTimer::timeout, this, &VeQItemPollScheduler::onWakeup);
+}
+
+// Owned by the application, so its timer doesn't outlive the event loop.
+VeQItemPollScheduler *VeQItemPollScheduler::instance()
+{
+	static QPointer<VeQItemPollScheduler> theScheduler;
+	if (!theScheduler)
+		theScheduler = new VeQItemPollScheduler(QCoreApplication::instance());
+	return theScheduler;
+}
+
+void VeQItemPollScheduler::add(VeQItem *item, Poller const &poller, int periodMs,
+							   Priority priority, Mode mode)
+{
+	remove(item);
+
+	Entry &entry = mEntries[item];
+	entry.poller = poller;
+	entry.period = qMax(periodMs, 1);
+	entry.priority = priority;
+	entry.mode = mode;
+	entry.due = -1;
+
+	// Get a value right away when someone is interested, otherwise spread the first
+	// checks, so registering many items at once doesn't cause a burst.
+	qint64 now = mClock.elapsed();
+	bool pollNow = mode == PollAlways || item->isWatched();
+	if (pollNow)
+		schedule(item, entry, nextDue(entry, now));
+	else
+		schedule(item, entry, now + QRandomGenerator::global()->bounded(entry.period));
+
+	connect(item, &QObject::destroyed, this, &VeQItemPollScheduler::onItemDestroyed);
+	connect(item, &VeQItem::watchedStateChanged, this, &VeQItemPollScheduler::onWatchedStateChanged);
+
+	rearm();
+
+	if (pollNow)
+		poller(item);
+}
+
+void VeQItemPollScheduler::remove(VeQItem *item)
+{
+	auto it = mEntries.find(item);
+	if (it == mEntries.end())
+		return;
+
+	unschedule(item, it.value());
+	mEntries.erase(it);
+	item->disconnect(this);
+	rearm();
+}
+
+void VeQItemPollScheduler::onItemDestroyed(QObject *obj)
+{
+	// Mind it, the VeQItem part is already destructed, only use the pointer value.
+	VeQItem *item = static_cast<VeQItem *>(obj);
+	auto it = mEntries.find(item);
+	if (it == mEntries.end())
+		return;
+
+	unschedule(item, it.value());
+	mEntries.erase(it);
+	rearm();
+}
+
+void VeQItemPollScheduler::onWatchedStateChanged()
+{
+	VeQItem *item = static_cast<VeQItem *>(sender());
+	auto it = mEntries.find(item);
+	if (it == mEntries.end() || it->mode == PollAlways || it->due < 0 || !item->isWatched())
+		return;
+
+	// Someone started watching, don't let it wait for the next period.
+	unschedule(item, it.value());
+	schedule(item, it.value(), mClock.elapsed());
+	rearm();
+}
+
+void VeQItemPollScheduler::onWakeup()
+{
+	qint64 now = mClock.elapsed();
+	QList<QPair<Priority, VeQItem *>> due;
+
+	// Take everything which is due within the coalescing window, so items with
+	// almost the same deadline share this wakeup instead of each getting their own.
+	while (!mQueue.isEmpty() && mQueue.firstKey() <= now + mCoalescingWindow) {
+		auto first = mQueue.begin();
+		Entry &entry = mEntries[first.value()];
+		entry.due = -1;
+		due.append(qMakePair(entry.priority, first.value()));
+		mQueue.erase(first);
+	}
+
+	std::stable_sort(due.begin(), due.end(),
+		[](QPair<Priority, VeQItem *> const &a, QPair<Priority, VeQItem *> const &b) {
+			return a.first < b.first;
+		});
+
+	int polled = 0;
+	for (QPair<Priority, VeQItem *> const &i: due) {
+		VeQItem *item = i.second;
+
+		// A poll of another item might have removed or re-added this one.
+		auto it = mEntries.find(item);
+		if (it == mEntries.end() || it->due >= 0)
+			continue;
+
+		if (it->mode == PollWhenWatched && !item->isWatched()) {
+			schedule(item, it.value(), nextDue(it.value(), now));
+			continue;
+		}
+
+		if (mMaxPollsPerWakeup > 0 && polled >= mMaxPollsPerWakeup && it->priority != Alarm) {
+			schedule(item, it.value(), now + mCoalescingWindow);
+			continue;
+		}
+
+		schedule(item, it.value(), nextDue(it.value(), now));
+
+		// The poller might add / remove items, so don't keep a reference to the entry.
+		Poller poller = it->poller;
+		polled++;
+		poller(item);
+	}
+
+	rearm();
+}
+
+void VeQItemPollScheduler::schedule(VeQItem *item, Entry &entry, qint64 due)
+{
+	entry.due = due;
+	mQueue.insert(due, item);
+}
+
+// Entries being handled by onWakeup are not in the queue, marked by a negative due.
+void VeQItemPollScheduler::unschedule(VeQItem *item, Entry const &entry)
+{
+	if (entry.due >= 0)
+		mQueue.remove(entry.due, item);
+}
+
+void VeQItemPollScheduler::rearm()
+{
+	if (mQueue.isEmpty()) {
+		mTimer.stop();
+		return;
+	}
+
+	qint64 delay = qMax<qint64>(mQueue.firstKey() - mClock.elapsed(), 0);
+	mTimer.start(int(delay));
+}
+
+/*
+ * Some jitter prevents items with the same period from marching in lock step with
+ * other periodic work on the system. It only shortens the period, so values are
+ * never older than requested. The coalescing window groups them again.
+ */
+qint64 VeQItemPollScheduler::nextDue(Entry const &entry, qint64 now)
+{
+	int jitter = entry.period / 16;
+	return now + entry.period - (jitter > 0 ? QRandomGenerator::global()->bounded(jitter) : 0);
+}
@@ -0,0 +1,149 @@
+#include <QHash>
+#include <QtMath>
+
+#include <veutil/qt/ve_qitem_schema.hpp>
+#include <veutil/qt/ve_qitem_utils.hpp>
+
+namespace {
+
+struct SchemaNode
+{
+	VeQItem *item;
+	bool attached;
+};
+
+struct SchemaBranch
+{
+	VeQItem *parent;
+	QString id;
+	VeQItem *item;
+};
+
+/*
+ * A leaf holding values of the type of its schema entry, e.g. an Int entry stays an int
+ * when a double is written to it. Doubles are formatted like a VeQItemQuantity.
+ */
+class SchemaLeaf : public VeQItemFormattedLeaf
+{
+public:
+	SchemaLeaf(VeQItemSchemaEntry const &entry, QVariant const &initial) :
+		VeQItemFormattedLeaf(),
+		mType(entry.type),
+		mDecimals(entry.decimals),
+		mUnit(QString::fromUtf8(entry.unit))
+	{
+		produceValue(initial);
+	}
+
+	void produceValue(QVariant value, State state = Synchronized, bool forceChanged = false) override
+	{
+		if (value.isValid() && value.metaType().id() != mType && !value.convert(QMetaType(mType)))
+			value = QVariant();
+		VeQItemFormattedLeaf::produceValue(value, state, forceChanged);
+	}
+
+protected:
+	QString formatText(QVariant const &value) override
+	{
+		if (!value.isValid())
+			return "-";
+
+		if (mDecimals >= 0 && (mType == QMetaType::Double || mType == QMetaType::Float))
+			return QString::number(value.toDouble(), 'f', mDecimals) + mUnit;
+
+		return value.toString() + mUnit;
+	}
+
+private:
+	int const mType;
+	int const mDecimals;
+	QString const mUnit;
+};
+
+}
+
+/*
+ * Intermediate nodes are remembered by their path, so every path of the schema is
+ * only scanned once, instead of being split and walked from the root for every item.
+ */
+void VeQItemSchema::build(VeQItem *serviceRoot, VeQItemSchemaEntry const *entries, int count)
+{
+	Q_ASSERT(serviceRoot->producer());
+
+	QHash<QString, SchemaNode> nodes;
+	QList<SchemaBranch> branches;
+
+	nodes.reserve(2 * count);
+	nodes.insert(QString(), {serviceRoot, true});
+
+	for (int n = 0; n < count; n++) {
+		QString path = QString::fromLatin1(entries[n].path);
+		if (path.startsWith('/'))
+			path.remove(0, 1);
+
+		SchemaNode parent = nodes.value(QString());
+		int start = 0;
+
+		for (;;) {
+			int end = path.indexOf('/', start);
+			bool isLeaf = end < 0;
+			if (isLeaf)
+				end = path.size();
+
+			QString prefix = path.left(end);
+			auto it = nodes.constFind(prefix);
+			if (it == nodes.constEnd()) {
+				QString id = path.mid(start, end - start);
+				SchemaNode node = {parent.attached ? parent.item->itemChildren().value(id) : nullptr, true};
+
+				if (!node.item) {
+					node.item = isLeaf ? createLeaf(entries[n]) : serviceRoot->producer()->createItem();
+					node.attached = false;
+
+					// Nobody can be listening to a detached parent yet, so adding to it is cheap.
+					if (parent.attached)
+						branches.append({parent.item, id, node.item});
+					else
+						parent.item->itemAddChild(id, node.item);
+				}
+
+				it = nodes.insert(prefix, node);
+			}
+
+			if (isLeaf)
+				break;
+
+			parent = it.value();
+			start = end + 1;
+		}
+	}
+
+	for (SchemaBranch const &branch: branches)
+		branch.parent->itemAddChild(branch.id, branch.item);
+}
+
+VeQItem *VeQItemSchema::createLeaf(VeQItemSchemaEntry const &entry)
+{
+	QVariant defaultValue;
+	if (!qIsNaN(entry.defaultValue))
+		defaultValue = toVariant(entry.type, entry.defaultValue);
+
+	// The default is the initial value as well, so it is not invalid till first produced.
+	VeQItem *leaf = new SchemaLeaf(entry, defaultValue);
+
+	if (!qIsNaN(entry.min))
+		leaf->itemProduceProperty("min", toVariant(entry.type, entry.min));
+	if (!qIsNaN(entry.max))
+		leaf->itemProduceProperty("max", toVariant(entry.type, entry.max));
+	if (defaultValue.isValid())
+		leaf->itemProduceProperty("defaultValue", defaultValue);
+
+	return leaf;
+}
+
+QVariant VeQItemSchema::toVariant(QMetaType::Type type, double value)
+{
+	QVariant ret(value);
+	ret.convert(QMetaType(type));
+	return ret;
+}
@@ -0,0 +1,51 @@
+#include <QPointer>
+
+#include <veutil/qt/ve_qitem_settings_async.hpp>
+
+VeQItemSettingsAsync::VeQItemSettingsAsync(VeQItemSettings *settings, QObject *parent) :
+	QObject(parent),
+	mSettings(settings)
+{
+}
+
+QFuture<VeQItem *> VeQItemSettingsAsync::add(QString path, QVariant defaultValue,
+											 QVariant min, QVariant max, bool silent)
+{
+	SettingPromise promise(new QPromise<VeQItem *>());
+	promise->start();
+
+	if (mPromises.isEmpty())
+		QMetaObject::invokeMethod(this, [this] { flush(); }, Qt::QueuedConnection);
+
+	mPending.add(path, defaultValue, min, max, silent);
+	mPromises.append(promise);
+
+	return promise->future();
+}
+
+// The futures are finished even when this object is gone by the time the settings are added.
+void VeQItemSettingsAsync::flush()
+{
+	if (mPromises.isEmpty())
+		return;
+
+	VeQItemSettingsInfo info = mPending;
+	QList<SettingPromise> promises = mPromises;
+	mPending = VeQItemSettingsInfo();
+	mPromises.clear();
+
+	QPointer<VeQItemSettingsAsync> self(this);
+	mSettings->addSettingsAsync(info, [self, promises](QList<VeQItem *> const &items) {
+		bool success = true;
+
+		for (int n = 0; n < promises.count(); n++) {
+			VeQItem *item = items.value(n);
+			success = success && item;
+			promises[n]->addResult(item);
+			promises[n]->finish();
+		}
+
+		if (self)
+			emit self->settingsAdded(success);
+	});
+}
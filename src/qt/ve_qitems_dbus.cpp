@@ -1,23 +1,37 @@
+#include <algorithm>
+
 #include <QDBusMetaType>
 #include <QDebug>
 #include <QtDBus>
-#ifdef QT_XML_LIB
-#include <QtXml>
-#endif
+#include <QXmlStreamReader>
 
 #include <veutil/qt/ve_qitems_dbus.hpp>
 
+#include "ve_qitems_dbus_decoder.hpp"
+
 Q_DECLARE_METATYPE(StringMap)
 
 VeQItemDbus::VeQItemDbus(VeQItemDbusProducer *producer) :
 	VeQItem(producer),
-	mDbusService(0),
 	mRequestValueWhenOnline(false),
 	mRequestTextWhenOnline(false),
 	mRequestDefaultWhenOnline(false),
 	mRequestMaxWhenOnline(false),
-	mRequestMinWhenOnline(false)
+	mRequestMinWhenOnline(false),
+	mBatchedRequests(0),
+	mChangesMatched(false),
+	mPrevInService(nullptr),
+	mNextInService(nullptr),
+	mWriteInFlight(false),
+	mHasQueuedWrite(false)
+{
+}
+
+VeQItemDbus::~VeQItemDbus()
 {
+	// Note: on shutdown the service might be gone before its items.
+	if (mDbusService)
+		mDbusService->itemDestroyed(this);
 }
 
 VeQItemDbusProducer *VeQItemDbus::producer()
@@ -97,31 +111,68 @@ void VeQItemDbus::demarshallVariantForQml(QVariant &variant, QString &signature)
 
 void VeQItemDbus::onPropertiesChanged(const QVariantMap &changes)
 {
-	QMapIterator<QString, QVariant> i(changes);
-	QString dummy;
+	for (auto it = changes.constBegin(); it != changes.constEnd(); ++it)
+		applyBusItemProperty(it.key(), it.value());
+}
 
-	while (i.hasNext()) {
-		i.next();
-		if (i.key() == "Value") {
-			QVariant value(i.value());
-			demarshallVariantForQml(value, mSignature);
-			produceValue(value);
-		} else if (i.key() == "Text") {
-			QString value(i.value().toString());
-			produceText(value);
-		} else if (i.key() == "Max") {
-			QVariant value(i.value());
-			demarshallVariantForQml(value, dummy);
-			itemProduceProperty("max", value);
-		} else if (i.key() == "Min") {
-			QVariant value(i.value());
-			demarshallVariantForQml(value, dummy);
-			itemProduceProperty("min", value);
-		} else if (i.key() == "Default") {
-			QVariant value(i.value());
-			demarshallVariantForQml(value, dummy);
-			itemProduceProperty("defaultValue", value);
-		}
+int VeQItemDbus::busItemProperty(QString const &key)
+{
+	switch (key.isEmpty() ? 0 : key.at(0).unicode()) {
+	case 'V':
+		if (key == QLatin1String("Value"))
+			return ValueProperty;
+		break;
+	case 'T':
+		if (key == QLatin1String("Text"))
+			return TextProperty;
+		break;
+	case 'M':
+		if (key == QLatin1String("Max"))
+			return MaxProperty;
+		if (key == QLatin1String("Min"))
+			return MinProperty;
+		break;
+	case 'D':
+		if (key == QLatin1String("Default"))
+			return DefaultProperty;
+		break;
+	}
+
+	return UnknownProperty;
+}
+
+// A property as found in PropertiesChanged, ItemsChanged and the GetItems reply.
+void VeQItemDbus::applyBusItemProperty(QString const &key, QVariant value)
+{
+	int property = busItemProperty(key);
+	if (property == UnknownProperty)
+		return;
+
+	QString signature;
+	demarshallVariantForQml(value, signature);
+	applyDecodedProperty(property, value, signature);
+}
+
+void VeQItemDbus::applyDecodedProperty(int property, QVariant const &value, QString const &signature)
+{
+	switch (property) {
+	case ValueProperty:
+		if (!signature.isNull())
+			mSignature = signature;
+		produceValue(value);
+		break;
+	case TextProperty:
+		produceText(value.toString());
+		break;
+	case MaxProperty:
+		itemProduceProperty("max", value);
+		break;
+	case MinProperty:
+		itemProduceProperty("min", value);
+		break;
+	case DefaultProperty:
+		itemProduceProperty("defaultValue", value);
+		break;
 	}
 }
 
@@ -150,15 +201,16 @@ void VeQItemDbus::serviceRegistrationChanged(bool registered)
 				mRequestTextWhenOnline = false;
 				getText(true);
 			}
-			if (mRequestDefaultWhenOnline) {
+			// GetItems also returns min, max and the default, see getItemsDone.
+			if (mRequestDefaultWhenOnline && !mDbusService->mGetItemsActive) {
 				mRequestDefaultWhenOnline = false;
 				itemProperty("defaultValue", true);
 			}
-			if (mRequestMaxWhenOnline) {
+			if (mRequestMaxWhenOnline && !mDbusService->mGetItemsActive) {
 				mRequestMaxWhenOnline = false;
 				itemProperty("max", true);
 			}
-			if (mRequestMinWhenOnline) {
+			if (mRequestMinWhenOnline && !mDbusService->mGetItemsActive) {
 				mRequestMinWhenOnline = false;
 				itemProperty("min", true);
 			}
@@ -176,6 +228,11 @@ void VeQItemDbus::serviceRegistrationChanged(bool registered)
 		}
 
 	} else {
+		if (mHasQueuedWrite) {
+			producer()->mWritesDropped++;
+			mHasQueuedWrite = false;
+			mQueuedWrite = QVariant();
+		}
 		produceValue(QVariant(), Offline);
 		produceText(QString(), Offline);
 	}
@@ -192,6 +249,56 @@ void VeQItemDbus::getItemsDone()
 		mRequestTextWhenOnline = false;
 		getText(true);
 	}
+
+	// Only ask for what the bulk data didn't contain.
+	if (mRequestDefaultWhenOnline) {
+		mRequestDefaultWhenOnline = false;
+		if (mPropertyState.value("defaultValue") != Synchronized)
+			itemProperty("defaultValue", true);
+	}
+	if (mRequestMaxWhenOnline) {
+		mRequestMaxWhenOnline = false;
+		if (mPropertyState.value("max") != Synchronized)
+			itemProperty("max", true);
+	}
+	if (mRequestMinWhenOnline) {
+		mRequestMinWhenOnline = false;
+		if (mPropertyState.value("min") != Synchronized)
+			itemProperty("min", true);
+	}
+}
+
+// Returns the requests which are still not answered.
+int VeQItemDbus::outstandingRequests(int requests)
+{
+	int ret = 0;
+
+	if ((requests & VeDbusServicePrivate::RequestValue) && mState == Requested)
+		ret |= VeDbusServicePrivate::RequestValue;
+	if ((requests & VeDbusServicePrivate::RequestText) && mTextState == Requested)
+		ret |= VeDbusServicePrivate::RequestText;
+	if ((requests & VeDbusServicePrivate::RequestMin) && mPropertyState.value("min") == Requested)
+		ret |= VeDbusServicePrivate::RequestMin;
+	if ((requests & VeDbusServicePrivate::RequestMax) && mPropertyState.value("max") == Requested)
+		ret |= VeDbusServicePrivate::RequestMax;
+	if ((requests & VeDbusServicePrivate::RequestDefault) && mPropertyState.value("defaultValue") == Requested)
+		ret |= VeDbusServicePrivate::RequestDefault;
+
+	return ret;
+}
+
+void VeQItemDbus::postponeRequests(int requests)
+{
+	if (requests & VeDbusServicePrivate::RequestValue)
+		mRequestValueWhenOnline = true;
+	if (requests & VeDbusServicePrivate::RequestText)
+		mRequestTextWhenOnline = true;
+	if (requests & VeDbusServicePrivate::RequestMin)
+		mRequestMinWhenOnline = true;
+	if (requests & VeDbusServicePrivate::RequestMax)
+		mRequestMaxWhenOnline = true;
+	if (requests & VeDbusServicePrivate::RequestDefault)
+		mRequestDefaultWhenOnline = true;
 }
 
 void VeQItemDbus::produceValue(QVariant variant, State state, bool forceChanged)
@@ -208,57 +315,21 @@ void VeQItemDbus::produceText(QString text, State state)
 		mRequestTextWhenOnline = false;
 }
 
-#ifdef QT_XML_LIB
-void VeQItemDbus::introspectObtained(QDBusPendingCallWatcher *call)
-{
-	QDBusPendingReply<QString> reply = *call;
-	QDomDocument doc;
-
-	if (!reply.isValid()) {
-		qDebug() << "Cannot introspect object" <<  reply.error();
-	} else {
-		doc.setContent(reply.value());
-		QDomElement child = doc.firstChildElement().firstChildElement();
-		while (!child.isNull()) {
-			if (child.tagName() == "node") {
-				QString name = child.attribute("name");
-				itemGetOrCreate(name);
-			}
-
-			child = child.nextSiblingElement();
-		}
-	}
-
-	call->deleteLater();
-}
-
-class FreeDesktopIntrospect : public QDBusAbstractInterface
-{
-public:
-	FreeDesktopIntrospect(const QString &service, const QString &path,
-						   const QDBusConnection &connection, QObject *parent = 0) :
-		QDBusAbstractInterface(service, path, "org.freedesktop.DBus.Introspectable", connection, parent)
-	{
-	}
-};
-
-bool VeQItemDbus::introspect()
+/*
+ * Discovers the children of this item with Introspect, for services without GetItems.
+ * When recursive, the whole tree below it is discovered, see VeDbusServicePrivate::introspect.
+ */
+bool VeQItemDbus::introspect(bool recursive)
 {
-	FreeDesktopIntrospect iface(dbusServiceName(), dbusPath(), dbusConnection());
-
-	if (!iface.isValid()) {
+	if (!mDbusService || !dbusIsServiceRegistered()) {
 		qDebug() << "Cannot introspect object" << dbusPath();
 		return false;
 	}
 
-	QList<QVariant> argumentList;
-	QDBusPendingReply<QString> call = iface.asyncCallWithArgumentList("Introspect", argumentList);
-	QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(call, this);
-	connect(watcher, &QDBusPendingCallWatcher::finished, this, &VeQItemDbus::introspectObtained);
+	mDbusService->introspect(this, recursive);
 
 	return true;
 }
-#endif
 
 QDBusPendingCallWatcher *VeQItemDbus::asyncCall(const QString &method, DbusCallback returnMethod)
 {
@@ -266,6 +337,7 @@ QDBusPendingCallWatcher *VeQItemDbus::asyncCall(const QString &method, DbusCallb
 	QDBusPendingCall async = dbusConnection().asyncCall(msg);
 	QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(async, this);
 	connect(watcher, &QDBusPendingCallWatcher::finished, this, returnMethod);
+	mDbusService->trackCall(watcher);
 
 	return watcher;
 }
@@ -313,7 +385,7 @@ QVariant VeQItemDbus::getValue(bool force)
 		}
 
 		setState(Requested);
-		asyncCall("GetValue", &VeQItemDbus::valueObtained);
+		mDbusService->requestItem(this, VeDbusServicePrivate::RequestValue);
 	}
 
 	return mValue;
@@ -358,7 +430,7 @@ QString VeQItemDbus::getText(bool force)
 		}
 
 		setTextState(Requested);
-		asyncCall("GetText", &VeQItemDbus::textObtained);
+		mDbusService->requestItem(this, VeDbusServicePrivate::RequestText);
 	}
 
 	return mText;
@@ -404,22 +476,18 @@ void VeQItemDbus::minObtained(QDBusPendingCallWatcher *call)
 QVariant VeQItemDbus::itemProperty(const char *name, bool force)
 {
 	if (mPropertyState[name] == Idle || force) {
-		QString method;
 		bool *pending;
-		DbusCallback slot;
+		VeDbusServicePrivate::Request request;
 
 		if (QLatin1String(name) == "min") {
-			method = "GetMin";
 			pending = &mRequestMinWhenOnline;
-			slot = &VeQItemDbus::minObtained;
+			request = VeDbusServicePrivate::RequestMin;
 		} else if (QLatin1String(name) == "max") {
-			method = "GetMax";
 			pending = &mRequestMaxWhenOnline;
-			slot = &VeQItemDbus::maxObtained;
+			request = VeDbusServicePrivate::RequestMax;
 		} else if (QLatin1String(name) == "defaultValue") {
-			method = "GetDefault";
 			pending = &mRequestDefaultWhenOnline;
-			slot = &VeQItemDbus::defaultObtained;
+			request = VeDbusServicePrivate::RequestDefault;
 		} else {
 			return property(name);
 		}
@@ -432,7 +500,14 @@ QVariant VeQItemDbus::itemProperty(const char *name, bool force)
 		}
 
 		mPropertyState[name] = Requested;
-		asyncCall(method, slot);
+
+		// The GetItems reply being waited for contains it, see getItemsDone.
+		if (mDbusService->isGetItemsActive()) {
+			*pending = true;
+			return property(name);
+		}
+
+		mDbusService->requestItem(this, request);
 	}
 
 	return property(name);
@@ -458,22 +533,54 @@ void VeQItemDbus::setValueDone(QDBusPendingCallWatcher *call)
 	}
 
 	call->deleteLater();
+
+	mWriteInFlight = false;
+	if (mHasQueuedWrite) {
+		QVariant value = mQueuedWrite;
+		mHasQueuedWrite = false;
+		mQueuedWrite = QVariant();
+		sendValue(value);
+	}
 }
 
 int VeQItemDbus::setValue(const QVariant &value)
 {
-	if (!dbusIsServiceRegistered() || mState == Offline) {
+	// While a restarted service waits for its resync, its items are offline, but it is there.
+	if (!dbusIsServiceRegistered() || (mState == Offline && !mDbusService->isResyncPending())) {
 		qDebug() << "ignoring request for" << uniqueId() << "to set value" << logValue(value) << "(not online)";
 		return -1;
 	}
 
 	// no need to set values to the same again
-	if (mState == Storing && mPendingSetValue == value)
+	if (mState == Storing && (mHasQueuedWrite ? mQueuedWrite == value : mPendingSetValue == value))
 		return 0;
 
-	mPendingSetValue = value;
 	setState(Storing);
 
+	/*
+	 * E.g. dragging a slider sets many values per second. Only one write per item is
+	 * outstanding, the latest value is sent when it completes. Values superseded in
+	 * the meantime are not sent at all.
+	 */
+	if (mWriteInFlight) {
+		if (mHasQueuedWrite)
+			producer()->mWritesDropped++;
+		mHasQueuedWrite = mPendingSetValue != value;
+		mQueuedWrite = mHasQueuedWrite ? value : QVariant();
+		return 0;
+	}
+
+	sendValue(value);
+
+	return 0;
+}
+
+void VeQItemDbus::sendValue(QVariant const &value)
+{
+	mPendingSetValue = value;
+	mWriteInFlight = true;
+	producer()->mWritesSent++;
+
 	QDBusMessage msg = QDBusMessage::createMethodCall(mDbusService->owner(), dbusPath(), "com.victronenergy.BusItem", "SetValue");
 	if (value.isValid()) {
 		msg << QVariant::fromValue(QDBusVariant(value));
@@ -486,27 +593,68 @@ int VeQItemDbus::setValue(const QVariant &value)
 	QDBusPendingCall set = dbusConnection().asyncCall(msg);
 	QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(set, this);
 	connect(watcher, &QDBusPendingCallWatcher::finished, this, &VeQItemDbus::setValueDone);
-
-	return 0;
+	mDbusService->trackCall(watcher);
 }
 
 // hook just before the item is added
 void VeQItemDbus::setParent(QObject *parent)
 {
+	// A subtree can be moved or removed, it must not be found by its old paths anymore.
+	if (mDbusService)
+		mDbusService->forgetItems(this);
+
 	VeQItem::setParent(parent);
+	updateDbusPath();
+}
+
+// Sets the path of the item and its children, by which they are found in the service.
+void VeQItemDbus::updateDbusPath()
+{
+	QObject *parent = QObject::parent();
 
 	// If this is a dbus service check if it is known
-	if (parent == producer()->services()) {
+	if (!parent) {
+		mDbusPath.clear();
+		mDbusService = nullptr;
+	} else if (parent == producer()->services()) {
+		mDbusPath = "/";
 		mDbusService = producer()->dbusServiceGetOrCreate(id());
 		mDbusService->attachRootItem(this);
 	} else {
-		mDbusService = static_cast<VeQItemDbus *>(parent)->mDbusService;
+		VeQItemDbus *dbusParent = static_cast<VeQItemDbus *>(parent);
+		mDbusPath = (dbusParent->mDbusPath == "/" ? "/" : dbusParent->mDbusPath + "/") + id();
+		mDbusService = dbusParent->mDbusService;
+	}
+
+	if (mDbusService) {
+		mDbusService->mItemsByPath.insert(mDbusPath, this);
+		if (mDbusPath != "/")
+			mDbusService->linkItem(this);
+		if (mWatched && mIsLeaf)
+			mDbusService->itemWatchedChanged(this);
 	}
+
+	for (VeQItem *child: itemChildren())
+		static_cast<VeQItemDbus *>(child)->updateDbusPath();
+}
+
+// Children are only deleted later, make sure they are not found by path anymore.
+void VeQItemDbus::itemDeleteChild(VeQItem *child)
+{
+	if (mDbusService)
+		mDbusService->forgetItems(static_cast<VeQItemDbus *>(child));
+	VeQItem::itemDeleteChild(child);
+}
+
+void VeQItemDbus::watchedChanged()
+{
+	if (mDbusService && mIsLeaf)
+		mDbusService->itemWatchedChanged(this);
 }
 
 QString VeQItemDbus::dbusPath()
 {
-	return mDbusService->dbusPath(this);
+	return mDbusPath;
 }
 
 QString VeQItemDbus::dbusServiceName()
@@ -541,7 +689,44 @@ VeDbusServicePrivate::VeDbusServicePrivate(QString owner, QObject *parent) :
 	QObject(parent),
 	mOwner(owner),
 	mServiceRoot(0),
-	mGetItemsActive(false)
+	mGetItemsActive(false),
+	mRequestFlushScheduled(false),
+	mBulkRequestsSupported(true),
+	mSubtreeRequestsSupported(true),
+	mServiceMatched(false),
+	mItemsChangedSeen(false),
+	mOwnerLookupPending(false),
+	mGetItemsSent(false),
+	mDiscoveryQueuedAt(-1),
+	mDiscoveryStartedAt(-1),
+	mOwnerObtainedAt(-1),
+	mItemsObtainedAt(-1),
+	mItemsAppliedAt(-1),
+	mItemsObtained(0),
+	mFirstItem(nullptr),
+	mLastItem(nullptr),
+	mIterationNext(nullptr),
+	mIterating(false),
+	mBulkApplying(false),
+	mBulkGeneration(0),
+	mWasRegistered(false),
+	mResyncPending(false),
+	mResyncing(false),
+	mResyncGeneration(0),
+	mRestarts(0),
+	mResyncScheduledAt(-1),
+	mResyncCount(0),
+	mLastResyncDuration(-1),
+	mIntrospectInFlight(0),
+	mIntrospectedNodes(0),
+	mItemsSinceSupported(true),
+	mItemsSinceSent(false),
+	mItemsGeneration(0),
+	mItemsGenerationMarked(false),
+	mItemsMark(0),
+	mItemsChangedApplied(0),
+	mItemsChangedBase(0),
+	mDeltaResyncCount(0)
 {
 	// NOTE: don t do anything here, since the object is not attached to an item
 	// yet, all members are bound to fail. Use attachItem instead.
@@ -553,28 +738,96 @@ VeDbusServicePrivate::~VeDbusServicePrivate()
 		return;
 
 	// guess it is https://bugreports.qt.io/browse/QTBUG-29498
-	dbusConnection().disconnect(serviceName(), "", "com.victronenergy.BusItem" ,"PropertiesChanged",
-								this, SLOT(onPropertiesChanged(const QVariantMap &)));
+	if (mServiceMatched && !mItemsChangedSeen)
+		matchPropertiesChanged("", false);
+	for (QString const &path: mPathMatches)
+		matchPath(path, false);
 
 	dbusConnection().disconnect(serviceName(), "/", "com.victronenergy.BusItem" ,"ItemsChanged",
-								this, SLOT(onItemsChanged(ItemMap)));
+								changesReceiver(), SLOT(onItemsChanged(QDBusMessage)));
 
 	if (!producer()->getFindVictronServices())
 		dbusConnection().disconnect("org.freedesktop.DBus", "", "org.freedesktop.DBus",
 								 "NameOwnerChanged", QStringList() << serviceName(), "sss",
 								 producer(), SLOT(onServiceOwnerChanged(QString,QString,QString)));
+
+	if (mDecoder)
+		mDecoder->deleteLater();
+}
+
+/*
+ * All items of the service, except its root, are in a list through the items
+ * themselves. Unlike findChildren, going through them doesn't walk the QObject tree
+ * nor allocate. Items might be removed by the callback, the next one is remembered
+ * in the service for that reason, so this can't be nested.
+ */
+void VeDbusServicePrivate::linkItem(VeQItemDbus *item)
+{
+	item->mPrevInService = mLastItem;
+	item->mNextInService = nullptr;
+	if (mLastItem)
+		mLastItem->mNextInService = item;
+	else
+		mFirstItem = item;
+	mLastItem = item;
+}
+
+void VeDbusServicePrivate::unlinkItem(VeQItemDbus *item)
+{
+	if (!item->mPrevInService && mFirstItem != item)
+		return;
+
+	if (mIterationNext == item)
+		mIterationNext = item->mNextInService;
+
+	if (item->mPrevInService)
+		item->mPrevInService->mNextInService = item->mNextInService;
+	else
+		mFirstItem = item->mNextInService;
+
+	if (item->mNextInService)
+		item->mNextInService->mPrevInService = item->mPrevInService;
+	else
+		mLastItem = item->mPrevInService;
+
+	item->mPrevInService = nullptr;
+	item->mNextInService = nullptr;
 }
 
+template<typename F>
+void VeDbusServicePrivate::forEachItem(F const &f)
+{
+	Q_ASSERT(!mIterating);
+
+	mIterating = true;
+	for (VeQItemDbus *item = mFirstItem; item; item = mIterationNext) {
+		mIterationNext = item->mNextInService;
+		f(item);
+	}
+	mIterationNext = nullptr;
+	mIterating = false;
+}
 
 void VeDbusServicePrivate::attachRootItem(VeQItemDbus *serviceRoot)
 {
 	mServiceRoot = serviceRoot;
 
-	dbusConnection().connect(serviceName(), "", "com.victronenergy.BusItem" ,"PropertiesChanged",
-							 this, SLOT(onPropertiesChanged(QVariantMap)));
+	// With a decode thread, the signals are received and demarshalled by the decoder.
+	QThread *decodeThread = producer()->mDecodeThread;
+	if (decodeThread && !mDecodedQueue) {
+		mDecodedQueue.reset(new VeDbusDecodedQueue());
+		mDecodedQueue->statistics = producer()->mStatistics;
+		mDecoder = new VeDbusServiceDecoder(mDecodedQueue);
+		mDecoder->moveToThread(decodeThread);
+		connect(mDecoder, &VeDbusServiceDecoder::decodedAvailable, this, &VeDbusServicePrivate::applyDecoded,
+				Qt::QueuedConnection);
+	}
+
+	if (producer()->getSubscriptionMode() == VeQItemDbusProducer::SubscribeService)
+		matchService();
 
 	dbusConnection().connect(serviceName(), "/", "com.victronenergy.BusItem", "ItemsChanged",
-							this, SLOT(onItemsChanged(ItemMap)));
+							changesReceiver(), SLOT(onItemsChanged(QDBusMessage)));
 
 	if (!producer()->getFindVictronServices())
 		dbusConnection().connect("org.freedesktop.DBus", "", "org.freedesktop.DBus",
@@ -582,199 +835,1492 @@ void VeDbusServicePrivate::attachRootItem(VeQItemDbus *serviceRoot)
 								 producer(), SLOT(onServiceOwnerChanged(QString,QString,QString)));
 
 	/*
-	 * When added from the consuming side / found by registeredServiceNames,
-	 * the name owner might needs to be requested. It is already known when
-	 * found by a NameOwnerChange. This blocks, not sure it that matters...
+	 * When added from the consuming side / found by ListNames, the name owner needs
+	 * to be requested. It is already known when found by a NameOwnerChange. The
+	 * lookup is queued, so many services don't wait on each other one by one.
 	 */
 	if (mOwner.isNull()) {
-		QDBusReply<QString> reply = dbusConnection().interface()->serviceOwner(serviceName());
-		if (reply.isValid()) {
-			mOwner = reply.value();
-			serviceRoot->setState(VeQItem::Synchronized);
-		} else {
-			serviceRoot->setState(VeQItem::Offline);
-		}
+		mOwnerLookupPending = true;
+		serviceRoot->setState(VeQItem::Requested);
+		producer()->queueDiscovery(this);
+		return;
 	}
 
 	// Start bulk init now if the service is available, otherwise in serviceRegistrationChanged
 	getItems();
 }
 
-void VeDbusServicePrivate::getItems()
+void VeDbusServicePrivate::connectionLost()
 {
-	if (mServiceRoot->dbusIsServiceRegistered() && producer()->getBulkInit() && !mGetItemsActive) {
-		mGetItemsActive = true;
-		QDBusMessage msg = QDBusMessage::createMethodCall(owner(), "/", "com.victronenergy.BusItem", "GetItems");
-		QDBusPendingCall async = dbusConnection().asyncCall(msg);
-		QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(async, this);
-		connect(watcher, &QDBusPendingCallWatcher::finished, this, &VeDbusServicePrivate::itemsObtained);
-	}
+	if (isRegistered())
+		ownerChanged(mOwner, "");
 }
 
-void VeDbusServicePrivate::itemsObtained(QDBusPendingCallWatcher *call)
+/*
+ * The producer switched to a new connection, see VeQItemDbusProducer::reconnect.
+ * The match rules were registered with the old bus daemon, so they are added again,
+ * and since owners are unique per daemon, the owner is looked up again.
+ */
+void VeDbusServicePrivate::connectionChanged()
 {
-	QDBusPendingReply<ItemMap> reply = *call;
+	// Not in the tree (yet), it is looked up when it is attached.
+	if (!mServiceRoot) {
+		mOwner = QString();
+		return;
+	}
 
-	mGetItemsActive = false;
+	// The matches of the old connection are gone with it, don't restore them there.
+	forgetItemsChanged();
+	connectionLost();
 
-	if (reply.isError()) {
-		qDebug() << "Get Items failed" << serviceName();
-	} else {
-		ItemMap items = reply.value();
-		for (auto it = items.constBegin(); it != items.constEnd(); ++it)
-			handleItemProperties(it.key(), it.value());
-	}
+	if (mServiceMatched)
+		matchPropertiesChanged("", true);
+	for (QString const &path: mPathMatches)
+		matchPropertiesChanged(path, true);
 
-	// Note: always do this, since there is a time window between sending
-	// and receiving, there is a chance that even when the getItems was
-	// succesfull, there are still items which need to be obtained individually
-	// if it was created in the meantime.
-	foreach (VeQItemDbus *child, mServiceRoot->findChildren<VeQItemDbus *>())
-		child->getItemsDone();
+	dbusConnection().connect(serviceName(), "/", "com.victronenergy.BusItem", "ItemsChanged",
+							 changesReceiver(), SLOT(onItemsChanged(QDBusMessage)));
 
-	call->deleteLater();
+	if (!producer()->getFindVictronServices())
+		dbusConnection().connect("org.freedesktop.DBus", "", "org.freedesktop.DBus",
+								 "NameOwnerChanged", QStringList() << serviceName(), "sss",
+								 producer(), SLOT(onServiceOwnerChanged(QString,QString,QString)));
+
+	mOwner = QString();
+	mOwnerLookupPending = true;
+	producer()->queueDiscovery(this);
 }
 
-QString VeDbusServicePrivate::dbusPath(VeQItemDbus *item)
+void VeDbusServicePrivate::ownerObtained(QDBusPendingCallWatcher *call)
 {
-	return item->getRelId(mServiceRoot);
+	QDBusPendingReply<QString> reply = *call;
+
+	call->deleteLater();
+	mOwnerLookupPending = false;
+	mOwnerObtainedAt = producer()->mStartupClock.elapsed();
+
+	// A NameOwnerChanged might have been processed in the meantime.
+	if (mOwner.isNull()) {
+		if (reply.isValid()) {
+			ownerChanged("", reply.value());
+		} else {
+			mOwner = "";
+			mServiceRoot->setState(VeQItem::Offline);
+		}
+	}
+
+	producer()->discoveryCallDone();
 }
 
-void VeDbusServicePrivate::handleItemProperties(const QString &path, const QVariantMap &changes)
+void VeDbusServicePrivate::startDiscoveryCall()
 {
-	VeQItem *item;
+	mDiscoveryStartedAt = producer()->mStartupClock.elapsed();
+
+	if (mResyncPending) {
+		mResyncPending = false;
+		if (isRegistered()) {
+			mResyncing = true;
+			// Claim the GetItems for this slot, so the items don't request themselves.
+			if (producer()->getBulkInit() && mBulkRequestsSupported)
+				mGetItemsActive = true;
+			serviceRegistrationChanged(true);
+			if (!mGetItemsActive)
+				resyncDone();
+		}
+	}
 
-	if (producer()->getAutoCreateItems()) {
-		item = mServiceRoot->itemGetOrCreate(path);
-	} else {
-		item = mServiceRoot->itemGet(path);
-		if (!item)
+	// A NameOwnerChanged might have made the lookup superfluous in the meantime.
+	if (mOwnerLookupPending && mOwner.isNull()) {
+		QDBusMessage msg = QDBusMessage::createMethodCall("org.freedesktop.DBus", "/org/freedesktop/DBus",
+														  "org.freedesktop.DBus", "GetNameOwner");
+		msg << serviceName();
+		asyncCall(msg, &VeDbusServicePrivate::ownerObtained);
+		return;
+	}
+	mOwnerLookupPending = false;
+
+	if (mGetItemsActive && !mGetItemsSent) {
+		// Gone while waiting in the queue, getItems is called again when it is back.
+		if (isRegistered()) {
+			sendGetItems();
 			return;
+		}
+		mGetItemsActive = false;
 	}
 
-	static_cast<VeQItemDbus *>(item)->onPropertiesChanged(changes);
+	producer()->discoveryCallDone();
 }
 
-void VeDbusServicePrivate::onItemsChanged(ItemMap const &items)
+QDBusPendingCallWatcher *VeDbusServicePrivate::asyncCall(QDBusMessage const &msg, void (VeDbusServicePrivate::*slot)(QDBusPendingCallWatcher *))
 {
-	for (auto it = items.begin(); it != items.end(); ++it)
-		handleItemProperties(it.key(), it.value());
+	QDBusPendingCall async = dbusConnection().asyncCall(msg);
+	QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(async, this);
+	connect(watcher, &QDBusPendingCallWatcher::finished, this, slot);
+	trackCall(watcher);
+
+	return watcher;
 }
 
-void VeDbusServicePrivate::serviceRegistrationChanged(bool registered)
+/*
+ * With delta resyncs, GetItemsSince is used instead of GetItems. It returns all
+ * items as well, but also the generation to pass when the service comes back, see
+ * itemsSinceObtained.
+ */
+void VeDbusServicePrivate::sendGetItems()
 {
-	// Change the root item first, the none bulk case will set it to synchronized.
-	mServiceRoot->serviceRegistrationChanged(registered);
+	mGetItemsSent = true;
+	mItemsSinceSent = producer()->mDeltaResync && mItemsSinceSupported;
 
-	// The bulk case will overwrite the root state to requested when enabled.
-	if (registered)
-		getItems();
+	if (!mItemsSinceSent) {
+		QDBusMessage msg = QDBusMessage::createMethodCall(owner(), "/", "com.victronenergy.BusItem", "GetItems");
+		asyncCall(msg, &VeDbusServicePrivate::itemsObtained);
+		return;
+	}
 
-	// Update all items, if bulk is enabled, the GetValue / GetText will not be send here,
-	// since the bulk answer will (likely) have the values already.
-	foreach (VeQItemDbus *child, mServiceRoot->findChildren<VeQItemDbus *>())
-		child->serviceRegistrationChanged(registered);
+	// Without the values of before, only a complete reply is of use.
+	quint64 generation = mLastValues.isEmpty() ? 0 : mItemsGeneration;
+	QDBusMessage msg = QDBusMessage::createMethodCall(owner(), "/", "com.victronenergy.BusItem", "GetItemsSince");
+	msg << QVariant::fromValue(generation);
+	asyncCall(msg, &VeDbusServicePrivate::itemsObtained);
 }
 
-void VeDbusServicePrivate::ownerChanged(const QString &oldOwner, const QString &newOwner)
+/*
+ * A GetItemsSince reply only contains the items changed since the given generation,
+ * unless the service no longer knows, e.g. since it restarted. The other items get
+ * back the value and text they had when the service went away, see restoreValues.
+ */
+void VeDbusServicePrivate::itemsSinceObtained(QDBusMessage const &reply)
 {
-	mOwner = newOwner;
-	if (!mServiceRoot)
-		return;
+	QList<QVariant> arguments = reply.arguments();
 
-	if (oldOwner != "") // disconnect event
-		serviceRegistrationChanged(false);
+	if (reply.signature() != "a{sa{sv}}tb" || arguments.size() != 3) {
+		mItemsGeneration = 0;
+		mLastValues.clear();
+		return;
+	}
 
-	if (newOwner != "") // connect event
-		serviceRegistrationChanged(true);
+	markItemsGeneration(arguments[1].toULongLong());
+	if (arguments[2].toBool())
+		mLastValues.clear();
+	else
+		mDeltaResyncCount++;
 }
 
-/**
- * @brief VeQItemDbusProducer::VeQItemDbusProducer
- * @param root
- * @param id
- * @param findVictronServices
- *          There are two modus operandi. Well known services can be added and monitored for
- *          presence. com.victronenergy services typically have "something" unique added
- *          to the dbus service name to allow multiple service of the same kind (e.g. multiple
- *          battery banks, motors etc). Setting this flag will auto add all services starting
- *          with com.victronengy. (It will cause a warning to be displayed about connecting to
- *          a depecrated signal to monitor all services, which is exactly the intended, the warning
- *          is the BUG)
- * @param bulkInitOfNewService
- *          Use GetItems to sync all values at once.
- * @param parent
+/*
+ * Every ItemsChanged increments the generation of the service, so the generation of
+ * the values the items have is that of the last reply plus the ItemsChanged applied
+ * after it. The signals received before the reply are already part of its generation
+ * though, so counting starts once the ones which might still be queued are applied,
+ * by passing a mark along the same way. When in doubt that undercounts, which only
+ * makes the next delta larger.
  */
-VeQItemDbusProducer::VeQItemDbusProducer(VeQItem *root, QString id,
-										 bool findVictronServices, bool bulkInitOfNewService,
-										 QObject *parent)
-	: VeQItemProducer(root, id, parent),
-	  mDbus(QDBusConnection("")),
-	  mFindVictronServices(findVictronServices),
-	  mBulkInitOfNewService(bulkInitOfNewService),
-	  mAutoCreateItems(true)
+void VeDbusServicePrivate::markItemsGeneration(quint64 generation)
 {
-	qDBusRegisterMetaType<StringMap>();
-	qDBusRegisterMetaType<ItemMap>();
+	mItemsGeneration = generation;
+	mItemsGenerationMarked = false;
+	int mark = ++mItemsMark;
+
+	if (mDecoder) {
+		VeDbusServiceDecoder *decoder = mDecoder.data();
+		QMetaObject::invokeMethod(decoder, [decoder, mark]() { decoder->markGeneration(mark); }, Qt::QueuedConnection);
+	} else if (mBulkApplying) {
+		mDeferredUpdates.append([this, mark]() { itemsGenerationMarked(mark); });
+	} else {
+		itemsGenerationMarked(mark);
+	}
 }
 
-bool VeQItemDbusProducer::open(const QString &address, const QString &qtDbusName)
+void VeDbusServicePrivate::itemsGenerationMarked(int mark)
 {
-	// FIXME: find non blocking version, all signals / slots are stalled for
-	// 30 secs or so if this fails when connection by tcp/ip...
-	if (address == "session")
-		return open(QDBusConnection::connectToBus(QDBusConnection::SessionBus, qtDbusName));
-	if (address == "system")
-		return open(QDBusConnection::connectToBus(QDBusConnection::SystemBus, qtDbusName));
+	// A mark of an older reply, the generation is counted from the latest one.
+	if (mark != mItemsMark)
+		return;
 
-	return open(QDBusConnection::connectToBus(address, qtDbusName));
+	mItemsChangedBase = mItemsChangedApplied;
+	mItemsGenerationMarked = true;
 }
 
-bool VeQItemDbusProducer::open(const QDBusConnection &dbusConnection)
+quint64 VeDbusServicePrivate::itemsGenerationSeen()
 {
-	mDbus = dbusConnection;
+	if (mItemsGeneration == 0 || !mItemsGenerationMarked)
+		return mItemsGeneration;
+	return mItemsGeneration + (mItemsChangedApplied - mItemsChangedBase);
+}
 
-	if (!mDbus.isConnected())
-		return false;
+// Items which the delta nor any change covered get their value of before the disconnect.
+void VeDbusServicePrivate::restoreValues()
+{
+	for (LastValue const &last: std::as_const(mLastValues)) {
+		if (!last.item)
+			continue;
+		if (last.item->getState() != VeQItem::Synchronized)
+			last.item->produceValue(last.value);
+		if (last.hasText && last.item->getTextState() != VeQItem::Synchronized)
+			last.item->produceText(last.text);
+	}
+	mLastValues.clear();
+}
 
-	if (mFindVictronServices) {
-		QDBusConnectionInterface *interface = mDbus.interface();
-		connect(interface, &QDBusConnectionInterface::serviceOwnerChanged, this, &VeQItemDbusProducer::onServiceOwnerChanged);
+// Only needed when the service can tell what changed in the meantime.
+void VeDbusServicePrivate::rememberValues()
+{
+	mLastValues.clear();
 
-		QStringList registerServices = interface->registeredServiceNames();
-		foreach (QString name, registerServices) {
-			if (name.startsWith("com.victronenergy."))
-				services()->itemGetOrCreate(name, false);
-		}
+	if (!producer()->mDeltaResync || !producer()->getBulkInit() || !mItemsSinceSupported || mItemsGeneration == 0)
+		return;
+
+	// Some items might not have the values of that generation yet.
+	if (mBulkApplying) {
+		mItemsGeneration = 0;
+		return;
 	}
 
-	return true;
-}
+	mItemsGeneration = itemsGenerationSeen();
+	mItemsGenerationMarked = false;
 
-VeQItem *VeQItemDbusProducer::createItem()
-{
-	return new VeQItemDbus(this);
+	forEachItem([this](VeQItemDbus *item) {
+		if (item->isLeaf() && item->getState() == VeQItem::Synchronized) {
+			bool hasText = item->getTextState() == VeQItem::Synchronized;
+			mLastValues.append({item, item->getLocalValue(), hasText ? item->getLocalText() : QString(), hasText});
+		}
+	});
 }
 
-/**
- * Setting this option to false will improve memory usage if you are interested in a few D-Bus items
- * per service.
- */
-void VeQItemDbusProducer::setAutoCreateItems(bool v)
+void VeDbusServicePrivate::getItems()
 {
-	if (mDbus.isConnected()) {
-		qDebug() << "cannot change 'autoCreateItems' flag when the producer has already been opened";
-		return;
+	if (mServiceRoot->dbusIsServiceRegistered() && producer()->getBulkInit() && !mGetItemsActive) {
+		mGetItemsActive = true;
+		producer()->queueDiscovery(this);
 	}
-	mAutoCreateItems = v;
 }
 
-// Finds not "well known services"
-void VeQItemDbusProducer::onServiceOwnerChanged(const QString &serviceName, const QString &oldOwner, const QString &newOwner)
+void VeDbusServicePrivate::itemsObtained(QDBusPendingCallWatcher *call)
+{
+	mGetItemsSent = false;
+	mItemsObtainedAt = producer()->mStartupClock.elapsed();
+	mItemsObtained = 0;
+	call->deleteLater();
+	applyDecoded();
+
+	if (call->isError()) {
+		mLastValues.clear();
+
+		// Keep the slot of the discovery window and get all items the old way instead.
+		if (mItemsSinceSent && call->error().type() == QDBusError::UnknownMethod && isRegistered()) {
+			mItemsSinceSupported = false;
+			sendGetItems();
+			return;
+		}
+
+		qDebug() << "Get Items failed" << serviceName();
+		if (call->error().type() == QDBusError::UnknownMethod)
+			mBulkRequestsSupported = false;
+		itemsApplied();
+		return;
+	}
+
+	if (mItemsSinceSent)
+		itemsSinceObtained(call->reply());
+	else
+		mLastValues.clear();
+
+	if (producer()->mBulkApplyBudget > 0) {
+		if (itemsArgument(call->reply(), mBulkItems)) {
+			mBulkApplying = true;
+			mBulkItems.beginMap();
+			applyItemsChunk(mBulkGeneration);
+			return;
+		}
+	} else {
+		mItemsObtained = applyItems(call->reply());
+	}
+
+	itemsApplied();
+}
+
+void VeDbusServicePrivate::itemsApplied()
+{
+	mGetItemsActive = false;
+	restoreValues();
+
+	// Note: always do this, since there is a time window between sending
+	// and receiving, there is a chance that even when the getItems was
+	// succesfull, there are still items which need to be obtained individually
+	// if it was created in the meantime.
+	forEachItem([](VeQItemDbus *item) { item->getItemsDone(); });
+
+	mItemsAppliedAt = producer()->mStartupClock.elapsed();
+	if (mResyncing)
+		resyncDone();
+	producer()->discoveryCallDone();
+}
+
+/*
+ * When a service restarts, all its items go offline and come back, each of them
+ * requesting its value and text again. When many services restart at once, e.g.
+ * after a firmware update, that floods the bus. Instead, the resync of a restarted
+ * service waits a random moment, longer when it keeps restarting, and then takes a
+ * slot of the discovery window, preferring a single GetItems for the whole service.
+ */
+void VeDbusServicePrivate::scheduleResync()
+{
+	VeQItemDbusProducer *p = producer();
+	qint64 now = p->mStartupClock.elapsed();
+
+	if (mResyncScheduledAt >= 0 && now - mResyncScheduledAt < p->mResyncRestartWindow)
+		mRestarts = qMin(mRestarts + 1, 16);
+	else
+		mRestarts = 0;
+
+	qint64 backoff = qMin<qint64>(p->mResyncBackoffMax, qint64(p->mResyncBackoffBase) * ((1 << mRestarts) - 1));
+	int delay = int(backoff);
+	if (p->mResyncJitter > 0)
+		delay += QRandomGenerator::global()->bounded(p->mResyncJitter + 1);
+
+	mResyncPending = true;
+	mResyncScheduledAt = now;
+	int generation = ++mResyncGeneration;
+
+	QTimer::singleShot(delay, this, [this, generation]() {
+		if (mResyncPending && generation == mResyncGeneration)
+			producer()->queueDiscovery(this);
+	});
+}
+
+void VeDbusServicePrivate::resyncDone()
+{
+	mResyncing = false;
+	mResyncCount++;
+	mLastResyncDuration = producer()->mStartupClock.elapsed() - mResyncScheduledAt;
+	emit producer()->serviceResynced(serviceName(), mLastResyncDuration);
+}
+
+/*
+ * Applying thousands of items at once, while creating them and emitting signals for
+ * them, blocks the event loop long enough for a gui to drop frames. With a bulk
+ * apply budget, a GetItems reply is applied in slices of that duration instead,
+ * giving the event loop a turn in between. Changes arriving meanwhile are newer than
+ * the reply, so they are held back till the reply is completely applied.
+ */
+void VeDbusServicePrivate::applyItemsChunk(int generation)
+{
+	// Aborted, e.g. since the service disappeared, see stopChunkedApply.
+	if (!mBulkApplying || generation != mBulkGeneration)
+		return;
+
+	QElapsedTimer timer;
+	timer.start();
+
+	while (!mBulkItems.atEnd()) {
+		applyItem(mBulkItems);
+		mItemsObtained++;
+
+		// Checking the time is cheap, but not free, so not after every item.
+		if ((mItemsObtained % 16) == 0 && timer.elapsed() >= producer()->mBulkApplyBudget) {
+			QMetaObject::invokeMethod(this, [this, generation]() { applyItemsChunk(generation); }, Qt::QueuedConnection);
+			return;
+		}
+	}
+
+	mBulkItems.endMap();
+	mBulkItems = QDBusArgument();
+	mBulkApplying = false;
+
+	QList<std::function<void()>> deferred;
+	deferred.swap(mDeferredUpdates);
+	for (std::function<void()> const &update: deferred)
+		update();
+
+	itemsApplied();
+}
+
+void VeDbusServicePrivate::stopChunkedApply()
+{
+	if (!mBulkApplying)
+		return;
+
+	mBulkGeneration++;
+	mBulkApplying = false;
+	mBulkItems = QDBusArgument();
+	mDeferredUpdates.clear();
+	itemsApplied();
+}
+
+void VeDbusServicePrivate::onPropertiesChanged(const QVariantMap &changes)
+{
+	QString path = message().path();
+
+	if (producer()->mStatistics) {
+		mStats.propertiesChangedSignals++;
+		mStats.itemsChanged++;
+		mStats.bytes += path.size();
+		for (auto it = changes.constBegin(); it != changes.constEnd(); ++it)
+			mStats.bytes += it.key().size() + VeDbusServiceStatistics::estimatedSize(it.value());
+	}
+
+	if (mBulkApplying) {
+		mDeferredUpdates.append([this, path, changes]() { handleItemProperties(path, changes); });
+		return;
+	}
+
+	QElapsedTimer timer;
+	timer.start();
+	handleItemProperties(path, changes);
+	if (producer()->mStatistics)
+		mStats.decodeNs += timer.nsecsElapsed();
+}
+
+/*
+ * Opening a page typically requests hundreds of values and texts at once. Instead of
+ * a call per item, the requests made within one event loop iteration are collected
+ * and answered by a single GetItems. Small batches and services without GetItems are
+ * still requested per item. Min, max and the default are part of the GetItems reply as
+ * well, so a page full of sliders doesn't cost three calls per slider either.
+ */
+static const int minBulkRequestSize = 8;
+
+void VeDbusServicePrivate::requestItem(VeQItemDbus *item, Request request)
+{
+	if (!item->isLeaf() || !producer()->getBulkInit() || !mBulkRequestsSupported) {
+		requestIndividually(item, request);
+		return;
+	}
+
+	if (item->mBatchedRequests == 0)
+		mRequestBatch.append(item);
+	item->mBatchedRequests |= request;
+
+	if (!mRequestFlushScheduled) {
+		mRequestFlushScheduled = true;
+		QMetaObject::invokeMethod(this, [this]() { flushRequests(); }, Qt::QueuedConnection);
+	}
+}
+
+void VeDbusServicePrivate::flushRequests()
+{
+	QList<BatchedRequest> batch;
+
+	mRequestFlushScheduled = false;
+	for (QPointer<VeQItemDbus> const &item: mRequestBatch) {
+		if (!item)
+			continue;
+		batch.append({item, item->mBatchedRequests});
+		item->mBatchedRequests = 0;
+	}
+	mRequestBatch.clear();
+
+	// Postpone, like getValue / getText do, till online or the bulk init is done.
+	if (!isRegistered() || mGetItemsActive) {
+		for (BatchedRequest const &entry: batch)
+			entry.item->postponeRequests(entry.requests);
+		return;
+	}
+
+	if (batch.size() < minBulkRequestSize) {
+		for (BatchedRequest const &entry: batch)
+			requestIndividually(entry.item, entry.requests);
+		return;
+	}
+
+	requestBatch(mSubtreeRequestsSupported ? commonAncestor(batch) : "/", batch);
+}
+
+/*
+ * Items requested together are typically of one subtree, e.g. when it becomes watched,
+ * so only that subtree is requested instead of the whole service.
+ */
+void VeDbusServicePrivate::requestBatch(QString const &path, QList<BatchedRequest> const &batch)
+{
+	QDBusMessage msg = QDBusMessage::createMethodCall(owner(), path, "com.victronenergy.BusItem", "GetItems");
+	QDBusPendingCall async = dbusConnection().asyncCall(msg);
+	QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(async, this);
+	connect(watcher, &QDBusPendingCallWatcher::finished, this, [this, path, batch](QDBusPendingCallWatcher *call) {
+		batchObtained(call, path, batch);
+	});
+	trackCall(watcher);
+}
+
+// The path of the deepest node all items of the batch are part of.
+QString VeDbusServicePrivate::commonAncestor(QList<BatchedRequest> const &batch)
+{
+	QString const &first = batch.first().item->mDbusPath;
+	QString ancestor = first.left(first.lastIndexOf('/'));
+
+	for (BatchedRequest const &entry: batch) {
+		QString const &path = entry.item->mDbusPath;
+		while (!ancestor.isEmpty() &&
+			   !(path.size() > ancestor.size() && path.startsWith(ancestor) && path.at(ancestor.size()) == '/'))
+			ancestor.truncate(ancestor.lastIndexOf('/'));
+	}
+
+	return ancestor.isEmpty() ? "/" : ancestor;
+}
+
+/*
+ * Without GetItems, a service tree can only be discovered by introspecting every
+ * node. Instead of one level per call, the nodes found are queued and introspected
+ * in turn, with a window of calls outstanding at once, so the whole tree is there
+ * after about depth round trips instead of one per node.
+ */
+void VeDbusServicePrivate::introspect(VeQItemDbus *item, bool recursive)
+{
+	if (mIntrospectInFlight == 0 && mIntrospectQueue.isEmpty())
+		mIntrospectedNodes = 0;
+
+	mIntrospectQueue.enqueue({item, recursive});
+	processIntrospectQueue();
+}
+
+void VeDbusServicePrivate::processIntrospectQueue()
+{
+	while (mIntrospectInFlight < producer()->mMaxIntrospectInFlight && !mIntrospectQueue.isEmpty()) {
+		IntrospectRequest request = mIntrospectQueue.dequeue();
+		if (!request.item || !isRegistered())
+			continue;
+
+		QDBusMessage msg = QDBusMessage::createMethodCall(owner(), dbusPath(request.item),
+														  "org.freedesktop.DBus.Introspectable", "Introspect");
+		QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(dbusConnection().asyncCall(msg), this);
+		connect(watcher, &QDBusPendingCallWatcher::finished, this, [this, request](QDBusPendingCallWatcher *call) {
+			introspectObtained(call, request);
+		});
+		trackCall(watcher);
+		mIntrospectInFlight++;
+	}
+
+	if (mIntrospectInFlight == 0 && mIntrospectQueue.isEmpty() && mIntrospectedNodes > 0) {
+		emit producer()->serviceIntrospected(serviceName(), mIntrospectedNodes);
+		mIntrospectedNodes = 0;
+	}
+}
+
+void VeDbusServicePrivate::introspectObtained(QDBusPendingCallWatcher *call, IntrospectRequest const &request)
+{
+	QDBusPendingReply<QString> reply = *call;
+
+	call->deleteLater();
+	mIntrospectInFlight--;
+	mIntrospectedNodes++;
+
+	if (!reply.isValid()) {
+		qDebug() << "Cannot introspect object" << reply.error();
+	} else if (request.item) {
+		for (QString const &name: childNodes(reply.value())) {
+			VeQItemDbus *child = static_cast<VeQItemDbus *>(request.item->itemGetOrCreate(name));
+			if (request.recursive)
+				mIntrospectQueue.enqueue({child, true});
+		}
+	}
+
+	processIntrospectQueue();
+}
+
+/*
+ * Only the names of the direct child nodes are needed, so the reply is scanned with
+ * a stream reader, skipping the interface descriptions, instead of building a DOM.
+ */
+QStringList VeDbusServicePrivate::childNodes(QString const &introspection)
+{
+	QStringList ret;
+	QXmlStreamReader xml(introspection);
+	int depth = 0;
+
+	while (!xml.atEnd()) {
+		switch (xml.readNext()) {
+		case QXmlStreamReader::StartElement:
+			if (depth == 1) {
+				if (xml.name() == QLatin1String("node")) {
+					QString name = xml.attributes().value("name").toString();
+					if (!name.isEmpty())
+						ret.append(name);
+				}
+				xml.skipCurrentElement();
+				break;
+			}
+			depth++;
+			break;
+		case QXmlStreamReader::EndElement:
+			depth--;
+			break;
+		default:
+			break;
+		}
+	}
+
+	if (xml.hasError())
+		qDebug() << "Invalid introspection data" << xml.errorString();
+
+	return ret;
+}
+
+void VeDbusServicePrivate::trackCall(QDBusPendingCallWatcher *watcher)
+{
+	if (!producer()->mStatistics)
+		return;
+
+	mStats.calls++;
+	mStats.pendingCalls++;
+	qint64 sentAt = producer()->mStartupClock.nsecsElapsed();
+
+	connect(watcher, &QDBusPendingCallWatcher::finished, this, [this, sentAt]() {
+		mStats.pendingCalls--;
+		mStats.addLatency((producer()->mStartupClock.nsecsElapsed() - sentAt) / 1000);
+	});
+}
+
+// Including what the decode thread counted.
+VeDbusServiceStatistics VeDbusServicePrivate::statistics()
+{
+	VeDbusServiceStatistics ret = mStats;
+
+	if (mDecodedQueue) {
+		ret.itemsChangedSignals += mDecodedQueue->itemsChangedSignals;
+		ret.propertiesChangedSignals += mDecodedQueue->propertiesChangedSignals;
+		ret.itemsChanged += mDecodedQueue->itemsChanged;
+		ret.bytes += mDecodedQueue->bytes;
+		ret.decodeNs += mDecodedQueue->decodeNs;
+	}
+
+	return ret;
+}
+
+void VeDbusServicePrivate::batchObtained(QDBusPendingCallWatcher *call, QString const &path,
+										 QList<BatchedRequest> const &batch)
+{
+	call->deleteLater();
+
+	if (call->isError()) {
+		/*
+		 * Older services only support GetItems on the root. The path might also just not
+		 * exist on the service though, so support is only given up when an item below it
+		 * was seen, i.e. the path is known to exist.
+		 */
+		if (call->error().type() == QDBusError::UnknownMethod && path != "/" && isRegistered()) {
+			for (BatchedRequest const &entry: batch) {
+				if (entry.item && entry.item->getSeen()) {
+					qDebug() << serviceName() << "doesn't support GetItems on" << path << "requesting all items";
+					mSubtreeRequestsSupported = false;
+					break;
+				}
+			}
+			requestBatch("/", batch);
+			return;
+		}
+
+		if (call->error().type() == QDBusError::UnknownMethod) {
+			qDebug() << serviceName() << "doesn't support GetItems, requesting items individually";
+			mBulkRequestsSupported = false;
+		}
+
+		for (BatchedRequest const &entry: batch) {
+			if (entry.item)
+				requestIndividually(entry.item, entry.requests);
+		}
+		return;
+	}
+
+	if (mBulkApplying) {
+		QDBusMessage reply = call->reply();
+		mDeferredUpdates.append([this, reply, batch]() { applyBatch(reply, batch); });
+		return;
+	}
+
+	applyBatch(call->reply(), batch);
+}
+
+void VeDbusServicePrivate::applyBatch(QDBusMessage const &reply, QList<BatchedRequest> const &batch)
+{
+	applyDecoded();
+	applyItems(reply);
+
+	// Whatever the reply didn't cover is still requested individually, which also
+	// reports paths which don't exist like before.
+	for (BatchedRequest const &entry: batch) {
+		if (!entry.item)
+			continue;
+
+		int missing = entry.item->outstandingRequests(entry.requests);
+		if (missing)
+			requestIndividually(entry.item, missing);
+	}
+}
+
+/*
+ * In SubscribeWatched mode only watched items have a match rule for their path.
+ * The dbus daemon would support path_namespace matches for whole subtrees, but
+ * QDBusConnection::connect can't express them, so it is per path, with the service
+ * wide match as fallback when there are too many of them.
+ */
+void VeDbusServicePrivate::itemWatchedChanged(VeQItemDbus *item)
+{
+	if (producer()->getSubscriptionMode() != VeQItemDbusProducer::SubscribeWatched)
+		return;
+
+	if (!item->mWatched) {
+		auto it = mPathMatches.find(item);
+		if (it != mPathMatches.end()) {
+			matchPath(it.value(), false);
+			mPathMatches.erase(it);
+			item->mChangesMatched = false;
+		}
+		return;
+	}
+
+	if (!mServiceMatched) {
+		if (mPathMatches.size() >= producer()->mMaxPathMatchesPerService ||
+				producer()->mPathMatches >= producer()->mMaxPathMatches) {
+			matchService();
+		} else {
+			QString path = dbusPath(item);
+			mPathMatches.insert(item, path);
+			matchPath(path, true);
+		}
+	}
+
+	// Changes were missed while nobody was watching, so get the current value again.
+	if (!item->mChangesMatched) {
+		item->mChangesMatched = true;
+		if (isRegistered()) {
+			item->getValue(true);
+			item->getText(true);
+		}
+	}
+}
+
+void VeDbusServicePrivate::itemDestroyed(VeQItemDbus *item)
+{
+	auto itemIt = mItemsByPath.find(item->mDbusPath);
+	if (itemIt != mItemsByPath.end() && itemIt.value() == item)
+		mItemsByPath.erase(itemIt);
+	unlinkItem(item);
+
+	if (!item->mWatched)
+		return;
+
+	auto it = mPathMatches.find(item);
+	if (it == mPathMatches.end())
+		return;
+
+	matchPath(it.value(), false);
+	mPathMatches.erase(it);
+}
+
+void VeDbusServicePrivate::matchPath(QString const &path, bool match)
+{
+	if (!mItemsChangedSeen)
+		matchPropertiesChanged(path, match);
+	producer()->mPathMatches += match ? 1 : -1;
+}
+
+// Once service wide, it stays like that, items which aren't watched still need a refresh though.
+void VeDbusServicePrivate::matchService()
+{
+	for (QString const &path: mPathMatches)
+		matchPath(path, false);
+	mPathMatches.clear();
+
+	if (!mItemsChangedSeen)
+		matchPropertiesChanged("", true);
+	mServiceMatched = true;
+}
+
+// An empty path matches PropertiesChanged of all objects of the service.
+void VeDbusServicePrivate::matchPropertiesChanged(QString const &path, bool match)
+{
+	if (match)
+		dbusConnection().connect(serviceName(), path, "com.victronenergy.BusItem", "PropertiesChanged",
+								 changesReceiver(), propertiesChangedSlot());
+	else
+		dbusConnection().disconnect(serviceName(), path, "com.victronenergy.BusItem", "PropertiesChanged",
+									changesReceiver(), propertiesChangedSlot());
+}
+
+/*
+ * A service emitting ItemsChanged reports all its changes with it, PropertiesChanged
+ * is then only sent along for older consumers. Once an ItemsChanged is received, the
+ * PropertiesChanged matches are dropped, so changes aren't received and decoded twice.
+ * Which matches are wanted is still administrated, so they can be restored when the
+ * name gets another owner, which might not emit ItemsChanged.
+ */
+void VeDbusServicePrivate::itemsChangedReceived()
+{
+	if (mItemsChangedSeen)
+		return;
+
+	if (mServiceMatched)
+		matchPropertiesChanged("", false);
+	for (QString const &path: mPathMatches)
+		matchPropertiesChanged(path, false);
+	mItemsChangedSeen = true;
+}
+
+void VeDbusServicePrivate::forgetItemsChanged()
+{
+	mItemsChangedSeen = false;
+	if (mDecodedQueue)
+		mDecodedQueue->itemsChangedSeen.store(false);
+}
+
+void VeDbusServicePrivate::restorePropertiesChanged()
+{
+	if (!mItemsChangedSeen)
+		return;
+
+	forgetItemsChanged();
+	if (mServiceMatched)
+		matchPropertiesChanged("", true);
+	for (QString const &path: mPathMatches)
+		matchPropertiesChanged(path, true);
+}
+
+QObject *VeDbusServicePrivate::changesReceiver()
+{
+	if (mDecoder)
+		return mDecoder;
+	return this;
+}
+
+const char *VeDbusServicePrivate::propertiesChangedSlot()
+{
+	if (mDecoder)
+		return SLOT(onPropertiesChanged(QDBusMessage));
+	return SLOT(onPropertiesChanged(QVariantMap));
+}
+
+/*
+ * Applies what the decode thread has demarshalled so far. Changes queued there
+ * before a GetItems reply is applied are older than the reply, so they are
+ * applied first, see itemsObtained.
+ */
+void VeDbusServicePrivate::applyDecoded()
+{
+	if (!mDecodedQueue)
+		return;
+
+	mDecodedQueue->notified.store(false);
+	if (!mItemsChangedSeen && mDecodedQueue->itemsChangedSeen.load())
+		itemsChangedReceived();
+
+	VeDbusDecodedBatch *batch;
+	while (mDecodedQueue->batches.pop(batch)) {
+		if (mBulkApplying) {
+			QSharedPointer<VeDbusDecodedBatch> deferred(batch);
+			mDeferredUpdates.append([this, deferred]() { applyDecodedBatch(*deferred); });
+			continue;
+		}
+
+		applyDecodedBatch(*batch);
+		delete batch;
+	}
+
+	// The decoder kept changes aside while the queue was full, there is room now.
+	if (mDecodedQueue->overflowed.exchange(false) && mDecoder)
+		QMetaObject::invokeMethod(mDecoder.data(), &VeDbusServiceDecoder::flushPending, Qt::QueuedConnection);
+}
+
+void VeDbusServicePrivate::applyDecodedBatch(VeDbusDecodedBatch const &batch)
+{
+	QElapsedTimer timer;
+	timer.start();
+
+	for (VeDbusDecodedProperty const &decoded: batch) {
+		VeQItemDbus *item = itemForPath(decoded.path);
+		if (item)
+			item->applyDecodedProperty(decoded.property, decoded.value, decoded.signature);
+	}
+
+	mItemsChangedApplied += batch.itemsChangedSignals;
+	if (batch.mark)
+		itemsGenerationMarked(batch.mark);
+
+	if (producer()->mStatistics)
+		mStats.decodeNs += timer.nsecsElapsed();
+}
+
+void VeDbusServicePrivate::requestIndividually(VeQItemDbus *item, int requests)
+{
+	if (requests & RequestValue)
+		item->asyncCall("GetValue", &VeQItemDbus::valueObtained);
+	if (requests & RequestText)
+		item->asyncCall("GetText", &VeQItemDbus::textObtained);
+	if (requests & RequestMin)
+		item->asyncCall("GetMin", &VeQItemDbus::minObtained);
+	if (requests & RequestMax)
+		item->asyncCall("GetMax", &VeQItemDbus::maxObtained);
+	if (requests & RequestDefault)
+		item->asyncCall("GetDefault", &VeQItemDbus::defaultObtained);
+}
+
+QString VeDbusServicePrivate::dbusPath(VeQItemDbus *item)
+{
+	return item->mDbusPath;
+}
+
+void VeDbusServicePrivate::forgetItems(VeQItemDbus *item)
+{
+	auto it = mItemsByPath.find(item->mDbusPath);
+	if (it != mItemsByPath.end() && it.value() == item)
+		mItemsByPath.erase(it);
+	unlinkItem(item);
+
+	// The match is on the old path, it is matched again when the item is added back.
+	auto match = mPathMatches.find(item);
+	if (match != mPathMatches.end()) {
+		matchPath(match.value(), false);
+		mPathMatches.erase(match);
+		item->mChangesMatched = false;
+	}
+
+	for (VeQItem *child: item->itemChildren())
+		forgetItems(static_cast<VeQItemDbus *>(child));
+}
+
+// The number of rejected paths remembered per service, see itemForPath.
+static const int maxFilteredPaths = 1024;
+
+/*
+ * All items of the service are in mItemsByPath, so only new items need to walk the
+ * tree. The path is as sent on the bus, so normally with a leading slash. Paths
+ * without it, and the root, are found by walking the tree, like itemGet does.
+ */
+VeQItemDbus *VeDbusServicePrivate::itemForPath(QString const &path)
+{
+	VeQItemDbus *item = mItemsByPath.value(path);
+	if (item)
+		return item;
+
+	if (!producer()->getAutoCreateItems()) {
+		if (path.startsWith('/') && path.size() > 1)
+			return nullptr;
+		return static_cast<VeQItemDbus *>(mServiceRoot->itemGet(path));
+	}
+
+	// Remember the rejected paths, so the filter doesn't run for every change. A service
+	// with ever changing paths would make that grow forever though, hence the limit.
+	if (mFilteredPaths.contains(path))
+		return nullptr;
+	if (!producer()->getFilter().acceptPath(serviceName(), path)) {
+		if (mFilteredPaths.size() >= maxFilteredPaths)
+			mFilteredPaths.clear();
+		mFilteredPaths.insert(path);
+		return nullptr;
+	}
+
+	return static_cast<VeQItemDbus *>(mServiceRoot->itemGetOrCreate(path));
+}
+
+void VeDbusServicePrivate::handleItemProperties(const QString &path, const QVariantMap &changes)
+{
+	VeQItemDbus *item = itemForPath(path);
+	if (item)
+		item->onPropertiesChanged(changes);
+}
+
+/*
+ * Instead of letting QtDBus demarshal ItemsChanged and the GetItems reply into an
+ * ItemMap first, which copies every path, key and value into maps only to be
+ * iterated once, the a{sa{sv}} argument is walked here and every property is
+ * applied to its item as soon as it is read.
+ */
+bool VeDbusServicePrivate::itemsArgument(QDBusMessage const &message, QDBusArgument &items)
+{
+	QList<QVariant> arguments = message.arguments();
+	QString signature = message.signature();
+
+	// GetItemsSince also returns the generation and whether all items are included.
+	if (!(signature == "a{sa{sv}}" && arguments.size() == 1) && !(signature == "a{sa{sv}}tb" && arguments.size() == 3)) {
+		qDebug() << "unexpected items signature" << message.signature() << serviceName();
+		return false;
+	}
+
+	items = qvariant_cast<QDBusArgument>(arguments[0]);
+	return true;
+}
+
+int VeDbusServicePrivate::applyItems(QDBusMessage const &message)
+{
+	QDBusArgument items;
+
+	if (!itemsArgument(message, items))
+		return 0;
+
+	return applyItems(items);
+}
+
+int VeDbusServicePrivate::applyItems(QDBusArgument const &items)
+{
+	int count = 0;
+
+	items.beginMap();
+	while (!items.atEnd()) {
+		applyItem(items);
+		count++;
+	}
+	items.endMap();
+
+	return count;
+}
+
+// Applies a single sa{sv} entry of the map.
+void VeDbusServicePrivate::applyItem(QDBusArgument const &items)
+{
+	QString path;
+	QString key;
+	QDBusVariant value;
+
+	items.beginMapEntry();
+	items >> path;
+	VeQItemDbus *item = itemForPath(path);
+	bool statistics = producer()->mStatistics;
+	if (statistics)
+		mStats.bytes += path.size();
+
+	items.beginMap();
+	while (!items.atEnd()) {
+		items.beginMapEntry();
+		items >> key >> value;
+		items.endMapEntry();
+		if (statistics)
+			mStats.bytes += key.size() + VeDbusServiceStatistics::estimatedSize(value.variant());
+		if (item)
+			item->applyBusItemProperty(key, value.variant());
+	}
+	items.endMap();
+
+	items.endMapEntry();
+}
+
+void VeDbusServicePrivate::onItemsChanged(QDBusMessage const &message)
+{
+	itemsChangedReceived();
+
+	if (mBulkApplying) {
+		mDeferredUpdates.append([this, message]() { applyItemsChanged(message); });
+		return;
+	}
+
+	applyItemsChanged(message);
+}
+
+// Counted when applied, so deferred signals are counted with their items.
+void VeDbusServicePrivate::applyItemsChanged(QDBusMessage const &message)
+{
+	if (message.signature() == "a{sa{sv}}")
+		mItemsChangedApplied++;
+
+	if (!producer()->mStatistics) {
+		applyItems(message);
+		return;
+	}
+
+	QElapsedTimer timer;
+	timer.start();
+	mStats.itemsChangedSignals++;
+	mStats.itemsChanged += applyItems(message);
+	mStats.decodeNs += timer.nsecsElapsed();
+}
+
+void VeDbusServicePrivate::serviceRegistrationChanged(bool registered)
+{
+	// The values being applied are of the previous owner.
+	stopChunkedApply();
+
+	// Change the root item first, the none bulk case will set it to synchronized.
+	mServiceRoot->serviceRegistrationChanged(registered);
+
+	// The bulk case will overwrite the root state to requested when enabled.
+	if (registered)
+		getItems();
+
+	// Update all items, if bulk is enabled, the GetValue / GetText will not be send here,
+	// since the bulk answer will (likely) have the values already.
+	forEachItem([registered](VeQItemDbus *item) { item->serviceRegistrationChanged(registered); });
+}
+
+void VeDbusServicePrivate::ownerChanged(const QString &oldOwner, const QString &newOwner)
+{
+	mOwner = newOwner;
+	if (!mServiceRoot)
+		return;
+
+	if (oldOwner != "") { // disconnect event
+		mResyncPending = false;
+		mResyncing = false;
+		mFilteredPaths.clear();
+		restorePropertiesChanged();
+		rememberValues();
+		serviceRegistrationChanged(false);
+	}
+
+	if (newOwner != "") { // connect event
+		// The first time is part of the discovery, a service coming back is resynced.
+		if (mWasRegistered && producer()->mResyncScheduling) {
+			scheduleResync();
+			return;
+		}
+		mWasRegistered = true;
+		serviceRegistrationChanged(true);
+	}
+}
+
+/**
+ * @brief VeQItemDbusProducer::VeQItemDbusProducer
+ * @param root
+ * @param id
+ * @param findVictronServices
+ *          There are two modus operandi. Well known services can be added and monitored for
+ *          presence. com.victronenergy services typically have "something" unique added
+ *          to the dbus service name to allow multiple service of the same kind (e.g. multiple
+ *          battery banks, motors etc). Setting this flag will auto add all services starting
+ *          with com.victronengy. (It will cause a warning to be displayed about connecting to
+ *          a depecrated signal to monitor all services, which is exactly the intended, the warning
+ *          is the BUG)
+ * @param bulkInitOfNewService
+ *          Use GetItems to sync all values at once.
+ * @param parent
+ */
+VeQItemDbusProducer::VeQItemDbusProducer(VeQItem *root, QString id,
+										 bool findVictronServices, bool bulkInitOfNewService,
+										 QObject *parent)
+	: VeQItemProducer(root, id, parent),
+	  mDbus(QDBusConnection("")),
+	  mFindVictronServices(findVictronServices),
+	  mBulkInitOfNewService(bulkInitOfNewService),
+	  mAutoCreateItems(true),
+	  mSubscriptionMode(SubscribeService),
+	  mPathMatches(0),
+	  mMaxPathMatches(256),
+	  mMaxPathMatchesPerService(32),
+	  mDiscoveryInFlight(0),
+	  mMaxDiscoveryInFlight(8),
+	  mListNamesPending(false),
+	  mStartupFinished(false),
+	  mListNamesTime(-1),
+	  mBulkApplyBudget(0),
+	  mUseDecodeThread(false),
+	  mDecodeThread(nullptr),
+	  mWritesSent(0),
+	  mWritesDropped(0),
+	  mResyncScheduling(false),
+	  mResyncBackoffBase(500),
+	  mResyncBackoffMax(30000),
+	  mResyncJitter(250),
+	  mResyncRestartWindow(60000),
+	  mDeltaResync(false),
+	  mStatistics(false),
+	  mStatisticsTimer(nullptr),
+	  mMaxIntrospectInFlight(16)
+{
+	qDBusRegisterMetaType<StringMap>();
+	qDBusRegisterMetaType<ItemMap>();
+}
+
+bool VeQItemDbusProducer::open(const QString &address, const QString &qtDbusName)
+{
+	// FIXME: find non blocking version, all signals / slots are stalled for
+	// 30 secs or so if this fails when connection by tcp/ip...
+	// VeQItemDbusAggregator connects on a thread of its own, use that for remote buses.
+	if (address == "session")
+		return open(QDBusConnection::connectToBus(QDBusConnection::SessionBus, qtDbusName));
+	if (address == "system")
+		return open(QDBusConnection::connectToBus(QDBusConnection::SystemBus, qtDbusName));
+
+	return open(QDBusConnection::connectToBus(address, qtDbusName));
+}
+
+VeQItemDbusProducer::~VeQItemDbusProducer()
+{
+	if (mDecodeThread) {
+		mDecodeThread->quit();
+		mDecodeThread->wait();
+
+		// The thread has stopped, so deleteLater wouldn't delete the decoders anymore.
+		for (VeDbusServicePrivate *service: std::as_const(mServiceWatchers))
+			delete service->mDecoder;
+	}
+}
+
+bool VeQItemDbusProducer::open(const QDBusConnection &dbusConnection)
+{
+	mDbus = dbusConnection;
+
+	if (!mDbus.isConnected())
+		return false;
+
+	if (mUseDecodeThread && !mDecodeThread) {
+		mDecodeThread = new QThread(this);
+		mDecodeThread->setObjectName("dbus decode");
+		mDecodeThread->start();
+	}
+
+	mStartupClock.start();
+
+	if (mFindVictronServices)
+		findServices();
+	else
+		QMetaObject::invokeMethod(this, [this]() { processDiscoveryQueue(); }, Qt::QueuedConnection);
+
+	return true;
+}
+
+void VeQItemDbusProducer::findServices()
+{
+	QDBusConnectionInterface *interface = mDbus.interface();
+	connect(interface, &QDBusConnectionInterface::serviceOwnerChanged, this, &VeQItemDbusProducer::onServiceOwnerChanged);
+
+	// Subscribed first, so services appearing meanwhile are not missed.
+	QDBusMessage msg = QDBusMessage::createMethodCall("org.freedesktop.DBus", "/org/freedesktop/DBus",
+													  "org.freedesktop.DBus", "ListNames");
+	QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(mDbus.asyncCall(msg), this);
+	connect(watcher, &QDBusPendingCallWatcher::finished, this, &VeQItemDbusProducer::serviceNamesObtained);
+	mListNamesPending = true;
+}
+
+// All services go offline, e.g. since the connection to the bus is lost.
+void VeQItemDbusProducer::connectionLost()
+{
+	for (VeDbusServicePrivate *service: std::as_const(mServiceWatchers))
+		service->connectionLost();
+}
+
+/*
+ * Continues on a new connection, e.g. to the same remote bus after the connection
+ * was lost. Unlike opening a new producer, the items stay, their services go offline
+ * and come back when they are found on the new connection.
+ */
+bool VeQItemDbusProducer::reconnect(const QDBusConnection &dbusConnection)
+{
+	if (mFindVictronServices && mDbus.interface())
+		disconnect(mDbus.interface(), nullptr, this, nullptr);
+
+	mDbus = dbusConnection;
+	if (!mDbus.isConnected()) {
+		connectionLost();
+		return false;
+	}
+
+	if (mFindVictronServices)
+		findServices();
+
+	for (VeDbusServicePrivate *service: std::as_const(mServiceWatchers))
+		service->connectionChanged();
+
+	return true;
+}
+
+void VeQItemDbusProducer::serviceNamesObtained(QDBusPendingCallWatcher *call)
+{
+	QDBusPendingReply<QStringList> reply = *call;
+
+	call->deleteLater();
+	mListNamesPending = false;
+	mListNamesTime = mStartupClock.elapsed();
+
+	if (reply.isError()) {
+		qDebug() << "ListNames failed" << reply.error();
+	} else {
+		for (QString const &name: reply.value()) {
+			if (name.startsWith("com.victronenergy.") && mFilter.acceptService(name))
+				services()->itemGetOrCreate(name, false);
+		}
+	}
+
+	processDiscoveryQueue();
+}
+
+void VeQItemDbusProducer::queueDiscovery(VeDbusServicePrivate *service)
+{
+	service->mDiscoveryQueuedAt = mStartupClock.elapsed();
+	mDiscoveryQueue.enqueue(service);
+	processDiscoveryQueue();
+}
+
+void VeQItemDbusProducer::discoveryCallDone()
+{
+	mDiscoveryInFlight--;
+	processDiscoveryQueue();
+}
+
+void VeQItemDbusProducer::processDiscoveryQueue()
+{
+	while (mDiscoveryInFlight < mMaxDiscoveryInFlight && !mDiscoveryQueue.isEmpty()) {
+		QPointer<VeDbusServicePrivate> service = mDiscoveryQueue.dequeue();
+		if (!service)
+			continue;
+		mDiscoveryInFlight++;
+		service->startDiscoveryCall();
+	}
+
+	if (!mStartupFinished && !mListNamesPending && mDiscoveryInFlight == 0 && mDiscoveryQueue.isEmpty()) {
+		mStartupFinished = true;
+		emit startupFinished();
+	}
+}
+
+QString VeQItemDbusProducer::startupReport()
+{
+	QString ret;
+	QTextStream out(&ret);
+
+	out << "ListNames: " << mListNamesTime << " ms\n";
+	for (auto it = mServiceWatchers.constBegin(); it != mServiceWatchers.constEnd(); ++it) {
+		VeDbusServicePrivate *service = it.value();
+		out << it.key() << ": queued at " << service->mDiscoveryQueuedAt << " ms, started at "
+			<< service->mDiscoveryStartedAt << " ms";
+		if (service->mOwnerObtainedAt >= 0)
+			out << ", owner at " << service->mOwnerObtainedAt << " ms";
+		if (service->mItemsObtainedAt >= 0)
+			out << ", " << service->mItemsObtained << " items at " << service->mItemsObtainedAt
+				<< " ms, applied at " << service->mItemsAppliedAt << " ms";
+		if (service->mResyncCount)
+			out << ", resynced " << service->mResyncCount << " times, last took "
+				<< service->mLastResyncDuration << " ms";
+		if (service->mDeltaResyncCount)
+			out << ", " << service->mDeltaResyncCount << " times with only the changes";
+		out << "\n";
+	}
+
+	return ret;
+}
+
+VeQItem *VeQItemDbusProducer::createItem()
+{
+	return new VeQItemDbus(this);
+}
+
+/**
+ * Setting this option to false will improve memory usage if you are interested in a few D-Bus items
+ * per service.
+ */
+void VeQItemDbusProducer::setAutoCreateItems(bool v)
+{
+	if (mDbus.isConnected()) {
+		qDebug() << "cannot change 'autoCreateItems' flag when the producer has already been opened";
+		return;
+	}
+	mAutoCreateItems = v;
+}
+
+void VeQItemDbusProducer::setSubscriptionMode(SubscriptionMode mode)
+{
+	if (mDbus.isConnected()) {
+		qDebug() << "cannot change the subscription mode when the producer has already been opened";
+		return;
+	}
+	mSubscriptionMode = mode;
+}
+
+void VeQItemDbusProducer::setMaxPathMatches(int total, int perService)
+{
+	mMaxPathMatches = total;
+	mMaxPathMatchesPerService = perService;
+}
+
+void VeQItemDbusProducer::setDecodeThread(bool enabled)
+{
+	if (mDbus.isConnected()) {
+		qDebug() << "cannot change the decode thread when the producer has already been opened";
+		return;
+	}
+	mUseDecodeThread = enabled;
+}
+
+void VeQItemDbusProducer::setStatistics(bool enabled)
+{
+	mStatistics = enabled;
+	for (VeDbusServicePrivate *service: std::as_const(mServiceWatchers)) {
+		if (service->mDecodedQueue)
+			service->mDecodedQueue->statistics = enabled;
+	}
+}
+
+void VeQItemDbusProducer::setStatisticsRoot(VeQItem *root, int intervalMs)
+{
+	mStatisticsRoot = root;
+
+	if (!root) {
+		delete mStatisticsTimer;
+		mStatisticsTimer = nullptr;
+		return;
+	}
+
+	setStatistics(true);
+	if (!mStatisticsTimer) {
+		mStatisticsTimer = new QTimer(this);
+		connect(mStatisticsTimer, &QTimer::timeout, this, &VeQItemDbusProducer::publishStatistics);
+	}
+	mStatisticsTimer->start(intervalMs);
+}
+
+void VeQItemDbusProducer::publishStatistics()
+{
+	if (!mStatisticsRoot)
+		return;
+
+	for (auto it = mServiceWatchers.constBegin(); it != mServiceWatchers.constEnd(); ++it) {
+		VeDbusServiceStatistics stats = it.value()->statistics();
+		VeQItem *service = mStatisticsRoot->itemGetOrCreate(it.key(), false);
+
+		service->itemGetOrCreateAndProduce("Signals/ItemsChanged", stats.itemsChangedSignals);
+		service->itemGetOrCreateAndProduce("Signals/PropertiesChanged", stats.propertiesChangedSignals);
+		service->itemGetOrCreateAndProduce("ItemsChanged", stats.itemsChanged);
+		service->itemGetOrCreateAndProduce("Bytes", stats.bytes);
+		service->itemGetOrCreateAndProduce("DecodeTime", stats.decodeNs / 1000000);
+		service->itemGetOrCreateAndProduce("Calls/Count", stats.calls);
+		service->itemGetOrCreateAndProduce("Calls/Pending", stats.pendingCalls);
+		service->itemGetOrCreateAndProduce("Calls/LatencyP50", stats.latencyPercentile(50));
+		service->itemGetOrCreateAndProduce("Calls/LatencyP99", stats.latencyPercentile(99));
+	}
+}
+
+QString VeQItemDbusProducer::statisticsReport()
+{
+	QList<QPair<QString, VeDbusServiceStatistics>> services;
+	for (auto it = mServiceWatchers.constBegin(); it != mServiceWatchers.constEnd(); ++it)
+		services.append({it.key(), it.value()->statistics()});
+
+	std::sort(services.begin(), services.end(), [](auto const &a, auto const &b) {
+		return a.second.itemsChanged > b.second.itemsChanged;
+	});
+
+	QString ret;
+	QTextStream out(&ret);
+
+	for (auto const &service: services) {
+		VeDbusServiceStatistics const &stats = service.second;
+		out << service.first << ": " << stats.itemsChangedSignals << " ItemsChanged, "
+			<< stats.propertiesChangedSignals << " PropertiesChanged, "
+			<< stats.itemsChanged << " items changed, ~" << stats.bytes << " bytes, decoding took "
+			<< stats.decodeNs / 1000000 << " ms, " << stats.calls << " calls, "
+			<< stats.pendingCalls << " pending, latency p50 " << stats.latencyPercentile(50)
+			<< " us, p99 " << stats.latencyPercentile(99) << " us\n";
+	}
+
+	return ret;
+}
+
+void VeQItemDbusProducer::setResyncBackoff(int baseMs, int maxMs, int jitterMs)
+{
+	mResyncBackoffBase = baseMs;
+	mResyncBackoffMax = maxMs;
+	mResyncJitter = jitterMs;
+}
+
+void VeQItemDbusProducer::setFilter(VeQItemDbusFilter const &filter)
+{
+	if (mDbus.isConnected()) {
+		qDebug() << "cannot change the filter when the producer has already been opened";
+		return;
+	}
+	mFilter = filter;
+}
+
+// Finds not "well known services"
+void VeQItemDbusProducer::onServiceOwnerChanged(const QString &serviceName, const QString &oldOwner, const QString &newOwner)
 {
 	Q_UNUSED(oldOwner);
 
-	if (!serviceName.startsWith("com.victronenergy."))
+	if (!serviceName.startsWith("com.victronenergy.") || !mFilter.acceptService(serviceName))
 		return;
 
 	// make sure there is a service object
@@ -804,7 +2350,7 @@ VeQItemDbusSettings::VeQItemDbusSettings(VeQItem *parent, QString id) :
 	qDBusRegisterMetaType<QVariantMapList>();
 }
 
-QDBusMessage VeQItemDbusSettings::sendAddSettings(VeQItemSettingsInfo const &settingsInfo)
+QDBusMessage VeQItemDbusSettings::createAddSettings(VeQItemSettingsInfo const &settingsInfo)
 {
 	QDBusMessage message = QDBusMessage::createMethodCall("com.victronenergy.settings",
 														  "/Settings",
@@ -829,12 +2375,16 @@ QDBusMessage VeQItemDbusSettings::sendAddSettings(VeQItemSettingsInfo const &set
 	QList<QVariant> arguments;
 	arguments.append(QVariant::fromValue(settings));
 	message.setArguments(arguments);
-	QDBusMessage reply = mConn.call(message);
 
-	return reply;
+	return message;
+}
+
+QDBusMessage VeQItemDbusSettings::sendAddSettings(VeQItemSettingsInfo const &settingsInfo)
+{
+	return mConn.call(createAddSettings(settingsInfo));
 }
 
-bool VeQItemDbusSettings::handleAddSettingsReply(QDBusMessage &reply)
+bool VeQItemDbusSettings::handleAddSettingsReply(VeQItem *root, QDBusMessage const &reply, QSet<VeQItem *> *added)
 {
 	bool ret = true;
 
@@ -858,7 +2408,9 @@ bool VeQItemDbusSettings::handleAddSettingsReply(QDBusMessage &reply)
 		}
 
 		QVariant value = result["value"];
-		root()->itemGetOrCreateAndProduce("Settings/" + path, value);
+		VeQItem *item = root->itemGetOrCreateAndProduce("Settings/" + path, value);
+		if (added)
+			added->insert(item);
 	}
 
 	return ret;
@@ -871,5 +2423,35 @@ bool VeQItemDbusSettings::addSettings(VeQItemSettingsInfo const &info)
 	if (reply.type() != QDBusMessage::ReplyMessage)
 		return false;
 
-	return handleAddSettingsReply(reply);
+	return handleAddSettingsReply(root(), reply);
+}
+
+/*
+ * The reply is matched by item instead of by path, since the path in the reply is
+ * not necessarily spelled the same as in the request, e.g. with a leading slash.
+ */
+void VeQItemDbusSettings::addSettingsAsync(VeQItemSettingsInfo const &info,
+										   std::function<void (QList<VeQItem *> const &items)> const &done)
+{
+	VeQItem *root = this->root();
+	QDBusPendingCall call = mConn.asyncCall(createAddSettings(info));
+	QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(call, root);
+
+	QObject::connect(watcher, &QDBusPendingCallWatcher::finished, root, [root, info, done](QDBusPendingCallWatcher *call) {
+		call->deleteLater();
+
+		QDBusMessage reply = call->reply();
+		QSet<VeQItem *> added;
+		if (reply.type() == QDBusMessage::ReplyMessage)
+			handleAddSettingsReply(root, reply, &added);
+		else
+			qDebug() << "AddSettings failed:" << reply.errorName() << reply.errorMessage();
+
+		QList<VeQItem *> items;
+		for (VeQItemSettingInfo const &setting: info.info()) {
+			VeQItem *item = root->itemGet("Settings/" + setting.mPath);
+			items.append(added.contains(item) ? item : nullptr);
+		}
+		done(items);
+	});
 }
@@ -0,0 +1,204 @@
+#include <QDBusConnection>
+#include <QThread>
+
+#include <veutil/qt/ve_qitem.hpp>
+#include <veutil/qt/ve_qitems_dbus.hpp>
+#include <veutil/qt/ve_qitems_dbus_aggregator.hpp>
+
+VeQItemDbusAggregator::VeQItemDbusAggregator(VeQItem *root, QObject *parent) :
+	QObject(parent),
+	mRoot(root),
+	mBackoffMin(1000),
+	mBackoffMax(60000)
+{
+	mHealthTimer.setInterval(2000);
+	connect(&mHealthTimer, &QTimer::timeout, this, &VeQItemDbusAggregator::checkConnections);
+}
+
+VeQItemDbusAggregator::~VeQItemDbusAggregator()
+{
+	QList<QString> ids = mBuses.keys();
+	for (QString const &id: ids)
+		removeBus(id);
+
+	for (QThread *thread: std::as_const(mRetiredThreads)) {
+		thread->wait();
+		delete thread;
+	}
+}
+
+VeQItemDbusProducer *VeQItemDbusAggregator::addBus(QString const &id, QString const &address,
+												   bool findVictronServices, bool bulkInitOfNewService)
+{
+	if (mBuses.contains(id))
+		return mBuses[id]->producer;
+
+	Bus *bus = new Bus();
+	bus->id = id;
+	bus->address = address;
+	bus->producer = new VeQItemDbusProducer(mRoot, id, findVictronServices, bulkInitOfNewService, this);
+	bus->thread = new QThread();
+	bus->thread->setObjectName("dbus " + id);
+	bus->connector = new QObject();
+	bus->connector->moveToThread(bus->thread);
+	connect(bus->thread, &QThread::finished, bus->connector, &QObject::deleteLater);
+	bus->generation = 0;
+	bus->backoff = mBackoffMin;
+	bus->connecting = false;
+	bus->connected = false;
+	bus->opened = false;
+	bus->thread->start();
+	mBuses.insert(id, bus);
+
+	if (!mHealthTimer.isActive())
+		mHealthTimer.start();
+
+	// Queued, so the producer can be configured before it is opened.
+	QMetaObject::invokeMethod(this, [this, id]() {
+		Bus *bus = mBuses.value(id);
+		if (bus && !bus->connecting && !bus->connected)
+			connectBus(bus);
+	}, Qt::QueuedConnection);
+
+	return bus->producer;
+}
+
+/*
+ * Doesn't wait for a connect which is still in progress, its thread is only waited
+ * for when the aggregator is destructed.
+ */
+void VeQItemDbusAggregator::removeBus(QString const &id)
+{
+	Bus *bus = mBuses.take(id);
+	if (!bus)
+		return;
+
+	// Removing a bus can be triggered by a signal of its producer, e.g. from a slot.
+	VeQItem *services = bus->producer->services();
+	mRoot->itemDeleteChild(services);
+	bus->producer->deleteLater();
+
+	if (!bus->connectionName.isEmpty())
+		QDBusConnection::disconnectFromBus(bus->connectionName);
+	bus->thread->quit();
+	mRetiredThreads.append(bus->thread);
+	connect(bus->thread, &QThread::finished, this, [this, thread = bus->thread]() {
+		mRetiredThreads.removeOne(thread);
+		thread->deleteLater();
+	});
+
+	delete bus;
+}
+
+VeQItemDbusProducer *VeQItemDbusAggregator::producer(QString const &id) const
+{
+	Bus *bus = mBuses.value(id);
+	return bus ? bus->producer : nullptr;
+}
+
+bool VeQItemDbusAggregator::isConnected(QString const &id) const
+{
+	Bus *bus = mBuses.value(id);
+	return bus && bus->connected;
+}
+
+void VeQItemDbusAggregator::setReconnectBackoff(int minMs, int maxMs)
+{
+	mBackoffMin = minMs;
+	mBackoffMax = maxMs;
+}
+
+void VeQItemDbusAggregator::connectBus(Bus *bus)
+{
+	// Every attempt uses a new connection name, an old one might still be referred to.
+	QString oldName = bus->connectionName;
+	bus->generation++;
+	bus->connectionName = QString("%1-%2").arg(bus->id).arg(bus->generation);
+	bus->connecting = true;
+
+	QString id = bus->id;
+	QString address = bus->address;
+	QString name = bus->connectionName;
+	int generation = bus->generation;
+
+	// Runs on the thread of the bus. The aggregator waits for it before it is gone.
+	QMetaObject::invokeMethod(bus->connector, [this, id, address, name, oldName, generation]() {
+		if (!oldName.isEmpty())
+			QDBusConnection::disconnectFromBus(oldName);
+
+		QDBusConnection connection(name);
+		if (address == "session")
+			connection = QDBusConnection::connectToBus(QDBusConnection::SessionBus, name);
+		else if (address == "system")
+			connection = QDBusConnection::connectToBus(QDBusConnection::SystemBus, name);
+		else
+			connection = QDBusConnection::connectToBus(address, name);
+
+		bool connected = connection.isConnected();
+		if (!connected)
+			QDBusConnection::disconnectFromBus(name);
+
+		QMetaObject::invokeMethod(this, [this, id, generation, connected]() {
+			busConnectResult(id, generation, connected);
+		}, Qt::QueuedConnection);
+	}, Qt::QueuedConnection);
+}
+
+void VeQItemDbusAggregator::busConnectResult(QString const &id, int generation, bool connected)
+{
+	Bus *bus = mBuses.value(id);
+	if (!bus || bus->generation != generation)
+		return;
+
+	bus->connecting = false;
+
+	QDBusConnection connection(bus->connectionName);
+	if (connected && bus->opened) {
+		bus->producer->reconnect(connection);
+	} else if (connected && bus->producer->open(connection)) {
+		bus->opened = true;
+	} else {
+		int retryMs = bus->backoff;
+		scheduleReconnect(bus);
+		emit busConnectFailed(id, retryMs);
+		return;
+	}
+
+	bus->connected = true;
+	bus->backoff = mBackoffMin;
+	emit busConnected(id);
+}
+
+void VeQItemDbusAggregator::scheduleReconnect(Bus *bus)
+{
+	QString id = bus->id;
+	int generation = bus->generation;
+
+	QTimer::singleShot(bus->backoff, this, [this, id, generation]() {
+		Bus *bus = mBuses.value(id);
+		if (bus && bus->generation == generation && !bus->connecting && !bus->connected)
+			connectBus(bus);
+	});
+
+	bus->backoff = qMin(2 * bus->backoff, mBackoffMax);
+}
+
+// QDBusConnection has no signal for a lost connection, so it is polled.
+void VeQItemDbusAggregator::checkConnections()
+{
+	// A slot connected to busDisconnected might remove buses.
+	QList<QString> ids = mBuses.keys();
+	for (QString const &id: ids) {
+		Bus *bus = mBuses.value(id);
+		if (!bus || !bus->connected || bus->producer->dbusConnection().isConnected())
+			continue;
+
+		bus->connected = false;
+		bus->producer->connectionLost();
+		emit busDisconnected(id);
+
+		bus = mBuses.value(id);
+		if (bus)
+			scheduleReconnect(bus);
+	}
+}
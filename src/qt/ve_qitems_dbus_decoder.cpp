@@ -0,0 +1,184 @@
+#include <QDebug>
+#include <QElapsedTimer>
+
+#include <veutil/qt/ve_qitems_dbus.hpp>
+#include <veutil/qt/ve_qitems_dbus_statistics.hpp>
+
+#include "ve_qitems_dbus_decoder.hpp"
+
+VeDbusDecodedQueue::~VeDbusDecodedQueue()
+{
+	VeDbusDecodedBatch *batch;
+	while (batches.pop(batch))
+		delete batch;
+}
+
+VeDbusServiceDecoder::VeDbusServiceDecoder(QSharedPointer<VeDbusDecodedQueue> const &queue) :
+	mQueue(queue),
+	mPending(nullptr)
+{
+}
+
+VeDbusServiceDecoder::~VeDbusServiceDecoder()
+{
+	delete mPending;
+}
+
+void VeDbusServiceDecoder::onPropertiesChanged(const QDBusMessage &message)
+{
+	if (message.signature() != "a{sv}")
+		return;
+
+	QElapsedTimer timer;
+	timer.start();
+
+	VeDbusDecodedBatch *batch = new VeDbusDecodedBatch();
+	int bytes = decodeProperties(message.path(), qvariant_cast<QDBusArgument>(message.arguments().at(0)), *batch);
+
+	if (mQueue->statistics.load(std::memory_order_relaxed)) {
+		mQueue->propertiesChangedSignals++;
+		mQueue->itemsChanged++;
+		mQueue->bytes += bytes;
+		mQueue->decodeNs += timer.nsecsElapsed();
+	}
+
+	push(batch);
+}
+
+void VeDbusServiceDecoder::onItemsChanged(const QDBusMessage &message)
+{
+	if (message.signature() != "a{sa{sv}}")
+		return;
+
+	mQueue->itemsChangedSeen.store(true);
+
+	QElapsedTimer timer;
+	timer.start();
+
+	QDBusArgument const items = qvariant_cast<QDBusArgument>(message.arguments().at(0));
+	VeDbusDecodedBatch *batch = new VeDbusDecodedBatch();
+	QString path;
+	int count = 0;
+	int bytes = 0;
+
+	items.beginMap();
+	while (!items.atEnd()) {
+		items.beginMapEntry();
+		items >> path;
+		bytes += decodeProperties(path, items, *batch);
+		items.endMapEntry();
+		count++;
+	}
+	items.endMap();
+	batch->itemsChangedSignals = 1;
+
+	if (mQueue->statistics.load(std::memory_order_relaxed)) {
+		mQueue->itemsChangedSignals++;
+		mQueue->itemsChanged += count;
+		mQueue->bytes += bytes;
+		mQueue->decodeNs += timer.nsecsElapsed();
+	}
+
+	push(batch);
+}
+
+// Returns the estimated size of the properties when statistics are enabled.
+int VeDbusServiceDecoder::decodeProperties(QString const &path, QDBusArgument const &properties,
+										   VeDbusDecodedBatch &batch)
+{
+	QString key;
+	QDBusVariant value;
+	bool statistics = mQueue->statistics.load(std::memory_order_relaxed);
+	int bytes = statistics ? path.size() : 0;
+
+	properties.beginMap();
+	while (!properties.atEnd()) {
+		properties.beginMapEntry();
+		properties >> key >> value;
+		properties.endMapEntry();
+		if (statistics)
+			bytes += key.size() + VeDbusServiceStatistics::estimatedSize(value.variant());
+
+		VeDbusDecodedProperty decoded;
+		decoded.property = VeQItemDbus::busItemProperty(key);
+		if (decoded.property == VeQItemDbus::UnknownProperty)
+			continue;
+		decoded.path = path;
+		decoded.value = value.variant();
+		VeQItemDbus::demarshallVariantForQml(decoded.value, decoded.signature);
+		batch.append(decoded);
+	}
+	properties.endMap();
+
+	return bytes;
+}
+
+// Queued behind the signals received so far, see VeDbusServicePrivate::markItemsGeneration.
+void VeDbusServiceDecoder::markGeneration(int mark)
+{
+	VeDbusDecodedBatch *batch = new VeDbusDecodedBatch();
+	batch->mark = mark;
+	push(batch);
+}
+
+/*
+ * When the items are behind and the queue is full, the changes are kept aside and
+ * coalesced, so only the last value per path and property is applied once there is
+ * room again. Waiting for the items instead would block the decode thread, also
+ * when it is asked to quit.
+ */
+void VeDbusServiceDecoder::push(VeDbusDecodedBatch *batch)
+{
+	// An ItemsChanged without known properties still counts for the generation.
+	if (batch->isEmpty() && !batch->itemsChangedSignals && !batch->mark) {
+		delete batch;
+		return;
+	}
+
+	if (!mPending) {
+		mPending = batch;
+	} else {
+		// The mark then covers some later signals as well, which only undercounts.
+		mPending->itemsChangedSignals += batch->itemsChangedSignals;
+		if (batch->mark)
+			mPending->mark = batch->mark;
+
+		for (VeDbusDecodedProperty const &decoded: std::as_const(*batch)) {
+			if (mPendingIndex.isEmpty()) {
+				for (int n = 0; n < mPending->size(); n++)
+					mPendingIndex.insert(qMakePair(mPending->at(n).path, mPending->at(n).property), n);
+			}
+
+			auto it = mPendingIndex.constFind(qMakePair(decoded.path, decoded.property));
+			if (it != mPendingIndex.constEnd()) {
+				(*mPending)[it.value()] = decoded;
+			} else {
+				mPendingIndex.insert(qMakePair(decoded.path, decoded.property), mPending->size());
+				mPending->append(decoded);
+			}
+		}
+		delete batch;
+	}
+
+	flushPending();
+}
+
+// Also invoked by the service once it emptied the queue, see VeDbusServicePrivate::applyDecoded.
+void VeDbusServiceDecoder::flushPending()
+{
+	if (!mPending)
+		return;
+
+	if (!mQueue->batches.push(mPending)) {
+		mQueue->overflowed.store(true);
+		// The service might have emptied the queue before it could see the flag.
+		if (!mQueue->batches.push(mPending))
+			return;
+	}
+
+	mPending = nullptr;
+	mPendingIndex.clear();
+
+	if (!mQueue->notified.exchange(true))
+		emit decodedAvailable();
+}
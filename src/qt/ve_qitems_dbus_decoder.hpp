@@ -0,0 +1,118 @@
+#pragma once
+
+#include <atomic>
+
+#include <QDBusMessage>
+#include <QHash>
+#include <QObject>
+#include <QSharedPointer>
+#include <QVariant>
+#include <QVector>
+
+/*
+ * Single producer, single consumer queue without locks. One thread pushes, another
+ * pops. Push fails when the queue is full.
+ */
+template<typename T, int Capacity>
+class VeSpscQueue
+{
+public:
+	bool push(T const &value)
+	{
+		int tail = mTail.load(std::memory_order_relaxed);
+		int next = (tail + 1) % Capacity;
+		if (next == mHead.load(std::memory_order_acquire))
+			return false;
+		mSlots[tail] = value;
+		mTail.store(next, std::memory_order_release);
+		return true;
+	}
+
+	bool pop(T &value)
+	{
+		int head = mHead.load(std::memory_order_relaxed);
+		if (head == mTail.load(std::memory_order_acquire))
+			return false;
+		value = mSlots[head];
+		mHead.store((head + 1) % Capacity, std::memory_order_release);
+		return true;
+	}
+
+private:
+	T mSlots[Capacity];
+	std::atomic<int> mHead{0};
+	std::atomic<int> mTail{0};
+};
+
+// A property of an item as decoded from a PropertiesChanged or ItemsChanged signal.
+struct VeDbusDecodedProperty
+{
+	QString path;
+	int property;
+	QVariant value;
+	QString signature;
+};
+
+// The properties decoded from one or more signals.
+struct VeDbusDecodedBatch : public QVector<VeDbusDecodedProperty>
+{
+	// The number of ItemsChanged signals, see VeDbusServicePrivate::markItemsGeneration.
+	int itemsChangedSignals = 0;
+	int mark = 0;
+};
+
+// Shared by the decoder and its service, so neither outlives the queue.
+class VeDbusDecodedQueue
+{
+public:
+	~VeDbusDecodedQueue();
+
+	VeSpscQueue<VeDbusDecodedBatch *, 256> batches;
+	std::atomic<bool> notified{false};
+	// Set by the decoder when it kept changes aside since the queue was full.
+	std::atomic<bool> overflowed{false};
+	// Set once an ItemsChanged is received, see VeDbusServicePrivate::itemsChangedReceived.
+	std::atomic<bool> itemsChangedSeen{false};
+
+	// Counted by the decoder when statistics are enabled, see VeDbusServiceStatistics.
+	std::atomic<bool> statistics{false};
+	std::atomic<quint64> itemsChangedSignals{0};
+	std::atomic<quint64> propertiesChangedSignals{0};
+	std::atomic<quint64> itemsChanged{0};
+	std::atomic<quint64> bytes{0};
+	std::atomic<qint64> decodeNs{0};
+};
+
+/*
+ * Receives the PropertiesChanged and ItemsChanged signals of a single service on
+ * the decode thread of the producer and demarshals them there. The decoded
+ * properties are queued per message and the service is signalled once to pick up
+ * whatever is queued at that time, so the thread owning the items only needs to
+ * apply them.
+ */
+class VeDbusServiceDecoder : public QObject
+{
+	Q_OBJECT
+
+public:
+	VeDbusServiceDecoder(QSharedPointer<VeDbusDecodedQueue> const &queue);
+	~VeDbusServiceDecoder();
+
+signals:
+	void decodedAvailable();
+
+public slots:
+	void onPropertiesChanged(const QDBusMessage &message);
+	void onItemsChanged(const QDBusMessage &message);
+	void flushPending();
+	void markGeneration(int mark);
+
+private:
+	int decodeProperties(QString const &path, QDBusArgument const &properties, VeDbusDecodedBatch &batch);
+	void push(VeDbusDecodedBatch *batch);
+
+	QSharedPointer<VeDbusDecodedQueue> mQueue;
+	// Changes which didn't fit in the queue, only the last value per path and property.
+	VeDbusDecodedBatch *mPending;
+	QHash<QPair<QString, int>, int> mPendingIndex;
+};
@@ -0,0 +1,109 @@
+#include <veutil/qt/ve_qitems_dbus_filter.hpp>
+
+void VeQItemDbusFilter::includePaths(QString const &serviceType, QStringList const &patterns)
+{
+	addPatterns(mPaths[serviceType].include, patterns, '/');
+}
+
+void VeQItemDbusFilter::excludePaths(QString const &serviceType, QStringList const &patterns)
+{
+	addPatterns(mPaths[serviceType].exclude, patterns, '/');
+}
+
+bool VeQItemDbusFilter::acceptService(QString const &serviceName) const
+{
+	return mServices.accept(serviceName);
+}
+
+bool VeQItemDbusFilter::acceptPath(QString const &serviceName, QString const &path) const
+{
+	Rules const *rules = pathRules(serviceName);
+	return !rules || rules->accept(path);
+}
+
+// "com.victronenergy.battery.ttyO1" -> "battery"
+QString VeQItemDbusFilter::serviceType(QString const &serviceName)
+{
+	return serviceName.section('.', 2, 2);
+}
+
+/*
+ * Like QRegularExpression::wildcardToRegularExpression with NonPathWildcardConversion,
+ * which needs Qt 6.6: '*' and '?' also match the boundary, e.g. a '/' in a path.
+ */
+QRegularExpression VeQItemDbusFilter::globToRegularExpression(QString const &pattern)
+{
+	QString re;
+	int n = 0;
+
+	while (n < pattern.size()) {
+		QChar c = pattern.at(n++);
+
+		if (c == '*') {
+			re += ".*";
+		} else if (c == '?') {
+			re += '.';
+		} else if (c == '[' && pattern.indexOf(']', n + 1) > 0) {
+			int end = pattern.indexOf(']', n + 1);
+			QString set = pattern.mid(n, end - n);
+			n = end + 1;
+			if (set.startsWith('!'))
+				set[0] = '^';
+			re += '[' + set.replace('\\', "\\\\") + ']';
+		} else {
+			re += QRegularExpression::escape(QString(c));
+		}
+	}
+
+	return QRegularExpression(QRegularExpression::anchoredPattern(re));
+}
+
+void VeQItemDbusFilter::addPatterns(QList<Pattern> &list, QStringList const &patterns, QChar boundary)
+{
+	for (QString const &pattern: patterns) {
+		Pattern p;
+		p.boundary = boundary;
+		if (pattern.contains('*') || pattern.contains('?') || pattern.contains('['))
+			p.glob = globToRegularExpression(pattern);
+		else
+			p.prefix = pattern;
+		list.append(p);
+	}
+}
+
+VeQItemDbusFilter::Rules const *VeQItemDbusFilter::pathRules(QString const &serviceName) const
+{
+	auto it = mPaths.constFind(serviceType(serviceName));
+	if (it == mPaths.constEnd())
+		it = mPaths.constFind("*");
+	return it == mPaths.constEnd() ? nullptr : &it.value();
+}
+
+bool VeQItemDbusFilter::Pattern::matches(QString const &str) const
+{
+	if (prefix.isNull())
+		return glob.match(str).hasMatch();
+
+	if (!str.startsWith(prefix))
+		return false;
+
+	return str.size() == prefix.size() || prefix.endsWith(boundary) || str.at(prefix.size()) == boundary;
+}
+
+bool VeQItemDbusFilter::Rules::accept(QString const &str) const
+{
+	for (Pattern const &pattern: exclude) {
+		if (pattern.matches(str))
+			return false;
+	}
+
+	if (include.isEmpty())
+		return true;
+
+	for (Pattern const &pattern: include) {
+		if (pattern.matches(str))
+			return true;
+	}
+
+	return false;
+}
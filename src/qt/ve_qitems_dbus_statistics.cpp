@@ -0,0 +1,59 @@
+#include <algorithm>
+
+#include <QDBusArgument>
+#include <QDBusVariant>
+
+#include <veutil/qt/ve_qitems_dbus_statistics.hpp>
+
+void VeDbusServiceStatistics::addLatency(qint64 us)
+{
+	if (mLatencies.size() < latencySamples) {
+		mLatencies.append(us);
+		return;
+	}
+
+	mLatencies[mNextLatency] = us;
+	mNextLatency = (mNextLatency + 1) % latencySamples;
+}
+
+qint64 VeDbusServiceStatistics::latencyPercentile(int percentile) const
+{
+	if (mLatencies.isEmpty())
+		return -1;
+
+	QVector<qint64> sorted = mLatencies;
+	int n = qBound(0, (sorted.size() * percentile) / 100, sorted.size() - 1);
+	std::nth_element(sorted.begin(), sorted.begin() + n, sorted.end());
+
+	return sorted[n];
+}
+
+int VeDbusServiceStatistics::estimatedSize(QVariant const &value)
+{
+	switch (value.typeId()) {
+	case QMetaType::QString:
+		return value.toString().size();
+	case QMetaType::QByteArray:
+		return value.toByteArray().size();
+	case QMetaType::QVariantList: {
+		int ret = 0;
+		for (QVariant const &v: value.toList())
+			ret += estimatedSize(v);
+		return ret;
+	}
+	case QMetaType::QVariantMap: {
+		int ret = 0;
+		QVariantMap map = value.toMap();
+		for (auto it = map.constBegin(); it != map.constEnd(); ++it)
+			ret += it.key().size() + estimatedSize(it.value());
+		return ret;
+	}
+	default:
+		if (value.canConvert<QDBusVariant>())
+			return estimatedSize(qvariant_cast<QDBusVariant>(value).variant());
+		// Not demarshalled yet, its signature at least tells something about its size.
+		if (value.canConvert<QDBusArgument>())
+			return 8 * qvariant_cast<QDBusArgument>(value).currentSignature().size();
+		return 8;
+	}
+}
@@ -4,6 +4,9 @@ SOURCES += \
     $$PWD/unit_conversion.cpp \
     $$PWD/ve_qitem.cpp \
     $$PWD/ve_qitem_loader.cpp \
+    $$PWD/ve_qitem_poll_scheduler.cpp \
+    $$PWD/ve_qitem_schema.cpp \
+    $$PWD/ve_qitem_settings_async.cpp \
     $$PWD/ve_qitem_table_model.cpp \
     $$PWD/ve_qitem_tree_model.cpp \
 
@@ -11,6 +14,9 @@ HEADERS += \
     $$VE_UTIL_INC/qt/unit_conversion.hpp \
     $$VE_UTIL_INC/qt/ve_qitem.hpp \
     $$VE_UTIL_INC/qt/ve_qitem_loader.hpp \
+    $$VE_UTIL_INC/qt/ve_qitem_poll_scheduler.hpp \
+    $$VE_UTIL_INC/qt/ve_qitem_schema.hpp \
+    $$VE_UTIL_INC/qt/ve_qitem_settings_async.hpp \
     $$VE_UTIL_INC/qt/ve_qitem_table_model.hpp \
     $$VE_UTIL_INC/qt/ve_qitem_tree_model.hpp \
     $$VE_UTIL_INC/qt/ve_qitem_utils.hpp \
@@ -18,12 +24,20 @@ HEADERS += \
 contains(QT, dbus) {
     SOURCES += \
         $$PWD/ve_qitems_dbus.cpp \
+        $$PWD/ve_qitems_dbus_aggregator.cpp \
+        $$PWD/ve_qitems_dbus_decoder.cpp \
+        $$PWD/ve_qitems_dbus_filter.cpp \
+        $$PWD/ve_qitems_dbus_statistics.cpp \
         $$PWD/ve_qitem_exported_dbus_service.cpp \
         $$PWD/ve_qitem_exported_dbus_services.cpp \
 
     HEADERS += \
         $$PWD/ve_qitem_exported_dbus_service.hpp \
+        $$PWD/ve_qitems_dbus_decoder.hpp \
         $$VE_UTIL_INC/qt/ve_qitems_dbus.hpp \
+        $$VE_UTIL_INC/qt/ve_qitems_dbus_aggregator.hpp \
+        $$VE_UTIL_INC/qt/ve_qitems_dbus_filter.hpp \
+        $$VE_UTIL_INC/qt/ve_qitems_dbus_statistics.hpp \
         $$VE_UTIL_INC/qt/ve_qitem_exported_dbus_services.hpp \
 }
 